@@ -0,0 +1,102 @@
+#include <ChainBinomial_Sim.h>
+#include <time.h>
+
+// Compares ways of drawing transmission days in the chain binomial model, at a
+// per-day transmissibility that puts the network right at the epidemic
+// threshold (where epidemics are long and most neighbors escape infection):
+//
+//   lookup   -- rand_nonuniform_int() on the time_dist vector, once per neighbor
+//               (what ChainBinomial_Sim::infect_node() used to do)
+//   inverse  -- Transmission_Delay::rand_delay(), once per neighbor
+//   batched  -- Transmission_Delay::rand_skip() to jump to the neighbors that get
+//               infected, then rand_conditional_delay() for those only
+//
+// It then times complete ChainBinomial_Sim runs, which use the batched path.
+
+double seconds_since(clock_t start) { return ((double) clock() - start) / CLOCKS_PER_SEC; }
+
+void bench_network(string label, Network& net, int infectious_period) {
+    ChainBinomial_Sim sim(&net, infectious_period, 0.0);
+    double T_crit = sim.calc_critical_transmissibility();
+    double T = 1.0 - pow(1.0 - T_crit, 1.0 / infectious_period); // per day, so that T_overall == T_crit
+    sim.set_transmissibility(T);
+    vector<double> time_dist = sim.define_time_dist();
+    Transmission_Delay delay(T, infectious_period);
+    mt19937* rng = net.get_rng();
+
+    vector<Node*> nodes = net.get_nodes();
+    vector<int> degrees = net.get_deg_series();
+    const int rounds = 10;
+    long neighbor_ct = (long) rounds * sum(degrees);
+
+    cout << label << ": N = " << net.size() << ", mean degree = " << net.mean_deg()
+         << ", infectious period = " << infectious_period << ", T = " << T << endl;
+
+    long transmissions = 0;
+    clock_t start = clock();
+    for (int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < nodes.size(); i++) {
+            for (int j = 0; j < degrees[i]; j++) {
+                if (rand_nonuniform_int(time_dist, rng) < infectious_period) transmissions++;
+            }
+        }
+    }
+    double elapsed = seconds_since(start);
+    cout << "\tlookup \t" << 1e9 * elapsed / neighbor_ct << " ns/neighbor\ttransmissions: " << transmissions << endl;
+
+    transmissions = 0;
+    start = clock();
+    for (int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < nodes.size(); i++) {
+            for (int j = 0; j < degrees[i]; j++) {
+                if (delay.rand_delay(rng) > 0) transmissions++;
+            }
+        }
+    }
+    elapsed = seconds_since(start);
+    cout << "\tinverse\t" << 1e9 * elapsed / neighbor_ct << " ns/neighbor\ttransmissions: " << transmissions << endl;
+
+    transmissions = 0;
+    start = clock();
+    for (int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < nodes.size(); i++) {
+            int skip = delay.rand_skip(rng);
+            for (int j = 0; j < degrees[i]; j++) {
+                if (skip-- > 0) continue;
+                if (delay.rand_conditional_delay(rng) > 0) transmissions++;
+                skip = delay.rand_skip(rng);
+            }
+        }
+    }
+    elapsed = seconds_since(start);
+    cout << "\tbatched\t" << 1e9 * elapsed / neighbor_ct << " ns/neighbor\ttransmissions: " << transmissions << endl;
+
+    const int reps = 100;
+    long total_size = 0;
+    start = clock();
+    for (int i = 0; i < reps; i++) {
+        sim.rand_infect(10);
+        sim.run_simulation();
+        total_size += sim.epidemic_size();
+        sim.reset();
+    }
+    elapsed = seconds_since(start);
+    cout << "\tsimulation\t" << 1e3 * elapsed / reps << " ms/replicate\tmean epidemic size: " << (double) total_size / reps << endl;
+}
+
+int main() {
+    Network::seed(1234);
+    const int N = 100000;
+
+    Network poisson("poisson", Network::Undirected);
+    poisson.populate(N);
+    poisson.rand_connect_poisson(10);
+    bench_network("Poisson(10)", poisson, 10);
+
+    Network powerlaw("powerlaw", Network::Undirected);
+    powerlaw.populate(N);
+    powerlaw.rand_connect_powerlaw(2.0, 100);
+    bench_network("Power law(2, 100)", powerlaw, 10);
+
+    return 0;
+}
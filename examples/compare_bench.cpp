@@ -0,0 +1,367 @@
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Compares two epifire_bench result files, a baseline and a candidate:
+//
+//      ./compare_bench baseline.json candidate.json [options]
+//
+//      --threshold PCT         a case regresses if its median time grows by more
+//                              than PCT percent and the change is significant
+//                              (default 5)
+//      --memory-threshold PCT  or if its peak RSS grows by more than PCT percent
+//                              and at least 1 MB (default 10)
+//      --alpha A               significance level (default 0.05)
+//      --filter TEXT           only compare cases whose names contain TEXT
+//
+// Results are matched on case name and parameters (n, and T where there is
+// one), and printed by group (generate, network, simulate, io) with the
+// speedup (baseline median / candidate median), the two-sided p-value of a
+// Mann-Whitney U test on the per-repetition times, and the change in peak RSS.
+// The exit status is 1 if any case regressed, 2 if the files couldn't be read,
+// and 0 otherwise, so this can gate a build.  With fewer than 4 repetitions
+// per side no p-value can get below 0.05, so nothing is ever flagged as
+// slower; epifire_bench runs 5 by default.
+
+/***************************************************************************
+ * Just enough JSON for epifire_bench's output
+ **************************************************************************/
+struct JsonValue {
+    enum { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type;
+    double number;
+    string str;
+    vector<JsonValue> items;
+    vector< pair<string, JsonValue> > members;
+
+    JsonValue() : type(NUL), number(0) {}
+
+    const JsonValue* get(const string& key) const {
+        for (unsigned int i = 0; i < members.size(); i++) if (members[i].first == key) return &members[i].second;
+        return NULL;
+    }
+};
+
+class JsonParser {
+    public:
+        JsonParser(const string& text) : s(text), pos(0) {}
+
+        JsonValue parse() {
+            JsonValue v = value();
+            skip_space();
+            if (pos != s.size()) fail("trailing characters");
+            return v;
+        }
+
+    private:
+        const string& s;
+        size_t pos;
+
+        void fail(const string& what) {
+            ostringstream msg;
+            msg << "JSON error at character " << pos << ": " << what;
+            throw runtime_error(msg.str());
+        }
+
+        void skip_space() { while (pos < s.size() and isspace((unsigned char) s[pos])) pos++; }
+
+        void expect(char c) {
+            skip_space();
+            if (pos >= s.size() or s[pos] != c) fail(string("expected '") + c + "'");
+            pos++;
+        }
+
+        JsonValue value() {
+            skip_space();
+            if (pos >= s.size()) fail("unexpected end");
+            JsonValue v;
+            const char c = s[pos];
+            if (c == '{') {
+                v.type = JsonValue::OBJECT;
+                pos++;
+                skip_space();
+                if (s[pos] == '}') { pos++; return v; }
+                while (true) {
+                    skip_space();
+                    const string key = string_literal();
+                    expect(':');
+                    v.members.push_back(make_pair(key, value()));
+                    skip_space();
+                    if (pos < s.size() and s[pos] == ',') { pos++; continue; }
+                    expect('}');
+                    return v;
+                }
+            } else if (c == '[') {
+                v.type = JsonValue::ARRAY;
+                pos++;
+                skip_space();
+                if (s[pos] == ']') { pos++; return v; }
+                while (true) {
+                    v.items.push_back(value());
+                    skip_space();
+                    if (pos < s.size() and s[pos] == ',') { pos++; continue; }
+                    expect(']');
+                    return v;
+                }
+            } else if (c == '"') {
+                v.type = JsonValue::STRING;
+                v.str = string_literal();
+            } else if (s.compare(pos, 4, "true") == 0 or s.compare(pos, 5, "false") == 0) {
+                v.type = JsonValue::BOOL;
+                v.number = s[pos] == 't';
+                pos += s[pos] == 't' ? 4 : 5;
+            } else if (s.compare(pos, 4, "null") == 0) {
+                pos += 4;
+            } else {
+                v.type = JsonValue::NUMBER;
+                const char* start = s.c_str() + pos;
+                char* end;
+                v.number = strtod(start, &end);
+                if (end == start) fail("unexpected character");
+                pos += end - start;
+            }
+            return v;
+        }
+
+        // escapes other than \" and \\ aren't needed for benchmark names
+        string string_literal() {
+            if (pos >= s.size() or s[pos] != '"') fail("expected a string");
+            string out;
+            for (pos++; pos < s.size() and s[pos] != '"'; pos++) {
+                if (s[pos] == '\\' and pos + 1 < s.size()) pos++;
+                out += s[pos];
+            }
+            if (pos >= s.size()) fail("unterminated string");
+            pos++;
+            return out;
+        }
+};
+
+/***************************************************************************
+ * Benchmark results
+ **************************************************************************/
+struct Result {
+    string name;
+    string key;                 // name and parameters
+    string params;              // as printed
+    vector<double> times;
+    double median;
+    double peak_rss_kb;
+};
+
+double median_of(vector<double> v) {
+    sort(v.begin(), v.end());
+    const int n = v.size();
+    return n == 0 ? 0 : (v[(n-1)/2] + v[n/2]) / 2.0;
+}
+
+vector<Result> read_results(const string& filename) {
+    ifstream in(filename.c_str());
+    if (not in) throw runtime_error("Could not open " + filename);
+    stringstream buffer;
+    buffer << in.rdbuf();
+    const string text = buffer.str();
+    JsonValue root = JsonParser(text).parse();
+    const JsonValue* results = root.get("results");
+    if (not results or results->type != JsonValue::ARRAY) throw runtime_error(filename + " has no \"results\" array");
+
+    vector<Result> out;
+    for (unsigned int i = 0; i < results->items.size(); i++) {
+        const JsonValue& r = results->items[i];
+        const JsonValue* name = r.get("name");
+        const JsonValue* times = r.get("wall_s");
+        if (not name or not times) continue;
+        Result res;
+        res.name = name->str;
+        ostringstream params;
+        if (const JsonValue* n = r.get("n")) params << "n=" << (long) n->number;
+        if (const JsonValue* T = r.get("T")) params << " T=" << T->number;
+        res.params = params.str();
+        res.key = res.name + " " + res.params;
+        for (unsigned int j = 0; j < times->items.size(); j++) res.times.push_back(times->items[j].number);
+        res.median = median_of(res.times);
+        const JsonValue* rss = r.get("peak_rss_kb");
+        res.peak_rss_kb = rss ? rss->number : 0;
+        out.push_back(res);
+    }
+    return out;
+}
+
+/***************************************************************************
+ * Mann-Whitney U test
+ **************************************************************************/
+
+// Two-sided p-value for the null hypothesis that a and b come from the same
+// distribution.  Exact (by counting rank arrangements) for small samples
+// without ties; otherwise the normal approximation, with tie and continuity
+// corrections.
+double mann_whitney_p(const vector<double>& a, const vector<double>& b) {
+    const int m = a.size(), n = b.size(), N = m + n;
+    if (m == 0 or n == 0) return 1.0;
+
+    vector< pair<double, int> > all;
+    for (int i = 0; i < m; i++) all.push_back(make_pair(a[i], 0));
+    for (int i = 0; i < n; i++) all.push_back(make_pair(b[i], 1));
+    sort(all.begin(), all.end());
+
+    double rank_sum_a = 0, tie_term = 0;
+    bool ties = false;
+    for (int i = 0; i < N; ) {
+        int j = i;
+        while (j < N and all[j].first == all[i].first) j++;
+        const double mid_rank = (i + 1 + j) / 2.0;
+        const double t = j - i;
+        if (t > 1) { ties = true; tie_term += t * t * t - t; }
+        for (int k = i; k < j; k++) if (all[k].second == 0) rank_sum_a += mid_rank;
+        i = j;
+    }
+    const double U = rank_sum_a - m * (m + 1) / 2.0;
+
+    if (not ties and N <= 40) {
+        // ways[i][j][u]: arrangements of i a's and j b's in which a precedes b u times
+        const int max_u = m * n;
+        vector< vector< vector<double> > > ways(m + 1, vector< vector<double> >(n + 1, vector<double>(max_u + 1, 0.0)));
+        for (int i = 0; i <= m; i++) {
+            for (int j = 0; j <= n; j++) {
+                if (i == 0 or j == 0) { ways[i][j][0] = 1; continue; }
+                for (int u = 0; u <= i * j; u++) {
+                    // the largest value is either an a (beating all j b's) or a b
+                    ways[i][j][u] = (u >= j ? ways[i-1][j][u-j] : 0) + ways[i][j-1][u];
+                }
+            }
+        }
+        double total = 0, below = 0, above = 0;
+        for (int u = 0; u <= max_u; u++) {
+            total += ways[m][n][u];
+            if (u <= U + 1e-9) below += ways[m][n][u];
+            if (u >= U - 1e-9) above += ways[m][n][u];
+        }
+        return min(1.0, 2.0 * min(below, above) / total);
+    }
+
+    const double mean = m * n / 2.0;
+    const double var = m * n / 12.0 * ((N + 1) - tie_term / ((double) N * (N - 1)));
+    if (var <= 0) return 1.0;
+    const double z = max(0.0, fabs(U - mean) - 0.5) / sqrt(var);
+    return erfc(z / sqrt(2.0));
+}
+
+string seconds(double s) {
+    ostringstream out;
+    out << setprecision(4) << s;
+    return out.str();
+}
+
+// The p-value when every candidate time is longer than every baseline time,
+// the smallest the test can give for these sample sizes.  The samples are
+// distinct, as real timings are, so small ones get the exact test.
+double smallest_p(int m, int n) {
+    vector<double> a, b;
+    for (int i = 0; i < m; i++) a.push_back(i);
+    for (int i = 0; i < n; i++) b.push_back(m + i);
+    return mann_whitney_p(a, b);
+}
+
+/***************************************************************************
+ * Main
+ **************************************************************************/
+int main(int argc, char* argv[]) {
+    vector<string> files;
+    bool bad_args = false;
+    double threshold = 5, memory_threshold = 10, alpha = 0.05;
+    string filter = "";
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--threshold" and has_value) threshold = atof(argv[++i]);
+        else if (arg == "--memory-threshold" and has_value) memory_threshold = atof(argv[++i]);
+        else if (arg == "--alpha" and has_value) alpha = atof(argv[++i]);
+        else if (arg == "--filter" and has_value) filter = argv[++i];
+        else if (arg.size() > 1 and arg[0] == '-') bad_args = true;
+        else files.push_back(arg);
+    }
+    if (bad_args or files.size() != 2) {
+        cerr << "Usage: " << argv[0] << " baseline.json candidate.json [--threshold PCT] [--memory-threshold PCT] [--alpha A] [--filter TEXT]\n";
+        return 2;
+    }
+
+    vector<Result> baseline, candidate;
+    try {
+        baseline = read_results(files[0]);
+        candidate = read_results(files[1]);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+    map<string, const Result*> candidate_by_key;
+    for (unsigned int i = 0; i < candidate.size(); i++) candidate_by_key[ candidate[i].key ] = &candidate[i];
+
+    int slower = 0, faster = 0, more_memory = 0, compared = 0, underpowered = 0;
+    string group = "";
+    cout << setiosflags(ios::fixed);
+    for (unsigned int i = 0; i < baseline.size(); i++) {
+        const Result& b = baseline[i];
+        if (not filter.empty() and b.name.find(filter) == string::npos) continue;
+        const string this_group = b.name.substr(0, b.name.find('/'));
+        if (this_group != group) {
+            group = this_group;
+            cout << "\n" << group << "\n"
+                 << "  " << left << setw(40) << "case" << setw(20) << "params" << right
+                 << setw(12) << "base (s)" << setw(12) << "cand (s)" << setw(9) << "speedup"
+                 << setw(9) << "p" << setw(10) << "RSS" << "  " << endl;
+        }
+        cout << "  " << left << setw(40) << b.name << setw(20) << b.params << right;
+
+        map<string, const Result*>::iterator match = candidate_by_key.find(b.key);
+        if (match == candidate_by_key.end()) {
+            cout << setw(12) << seconds(b.median) << setw(12) << "-" << "   (not in candidate)" << endl;
+            continue;
+        }
+        const Result& c = *match->second;
+        candidate_by_key.erase(match);
+        compared++;
+
+        const double p = mann_whitney_p(b.times, c.times);
+        const double speedup = c.median > 0 ? b.median / c.median : 0;
+        const double rss_change = b.peak_rss_kb > 0 ? 100.0 * (c.peak_rss_kb - b.peak_rss_kb) / b.peak_rss_kb : 0;
+        const bool too_few = smallest_p(b.times.size(), c.times.size()) >= alpha;
+        if (too_few) underpowered++;
+
+        string verdict = "";
+        if (p < alpha and c.median > b.median * (1 + threshold / 100)) { verdict = "SLOWER"; slower++; }
+        else if (p < alpha and c.median < b.median * (1 - threshold / 100)) { verdict = "faster"; faster++; }
+        else if (too_few and c.median > b.median * (1 + threshold / 100)) verdict = "slower? (too few repetitions)";
+        if (rss_change > memory_threshold and c.peak_rss_kb - b.peak_rss_kb >= 1024) {
+            verdict += verdict.empty() ? "MORE MEMORY" : ", MORE MEMORY";
+            more_memory++;
+        }
+
+        ostringstream rss;
+        rss << showpos << setprecision(1) << fixed << rss_change << "%";
+        cout << setw(12) << seconds(b.median) << setw(12) << seconds(c.median)
+             << setw(8) << setprecision(2) << speedup << "x" << setw(9) << setprecision(3) << p
+             << setw(10) << rss.str() << "  " << verdict << endl;
+    }
+    for (map<string, const Result*>::iterator it = candidate_by_key.begin(); it != candidate_by_key.end(); it++) {
+        if (not filter.empty() and it->second->name.find(filter) == string::npos) continue;
+        cout << "  " << left << setw(60) << it->first << right << "   (not in baseline)" << endl;
+    }
+
+    cout << "\n" << compared << " compared: " << slower << " slower, " << faster << " faster (by more than "
+         << setprecision(1) << threshold << "% at p < " << setprecision(3) << alpha << "), "
+         << more_memory << " using more than " << setprecision(1) << memory_threshold << "% more memory" << endl;
+    if (underpowered > 0) {
+        cout << "Warning: " << underpowered << " had too few repetitions for any difference to be significant" << endl;
+    }
+    return (slower > 0 or more_memory > 0) ? 1 : 0;
+}
@@ -0,0 +1,425 @@
+#include "Network.h"
+#include "Percolation_Sim.h"
+#include "ChainBinomial_Sim.h"
+#include "Gillespie_MassAction_Sim.h"
+#include "Gillespie_Network_SEIRS_Sim.h"
+#include "SIR_Sim.h"
+#include "Metapopulation_SEIR_Sim.h"
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Benchmarks for libepifire: network generators, network analyses, each
+// simulator, and edge list I/O, at sizes from 10^3 up to 10^7 (in powers of
+// ten), writing JSON to stdout:
+//
+//      ./epifire_bench [options] > bench.json
+//
+//      --reps R          timed repetitions of each case (default 5)
+//      --min-size N      smallest size to run (default 1000)
+//      --max-size N      largest size to run (default 100000; the full range
+//                        needs --max-size 10000000 and about 20 GB, mostly
+//                        for generating 10^7-node networks)
+//      --time-limit S    skip the next size of a case if ten times the median
+//                        time of this one exceeds S seconds (default 20)
+//      --filter TEXT     only run cases whose names contain TEXT
+//      --list            list the cases and their largest sizes, and exit
+//
+// or "make bench" in examples/, which writes bench.json (pass options with
+// BENCH_ARGS="...").  Each case and size runs in its own child process, so
+// that the peak resident memory reported is its own, and every repetition
+// builds its inputs again, untimed, with the RNG seeded by repetition number,
+// so runs of different builds see the same inputs.  For every case and size,
+// the output has its parameters (n, and T for simulators with a
+// transmissibility), the wall time of each repetition, their median, the
+// throughput (work items per second at the median time; "unit" says what an
+// item is) and the peak RSS.  compare_bench compares two such files.
+
+const double MEAN_DEGREE = 10;
+const double PERCOLATION_T = 0.2;
+const double CHAIN_BINOMIAL_T = 0.05;     // per day
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Times only the part of a case between start() and stop()
+class Stopwatch {
+    public:
+        Stopwatch() : seconds(0) {}
+        void start() { t0 = chrono::steady_clock::now(); }
+        void stop() { seconds += seconds_since(t0); }
+        double seconds;
+    private:
+        chrono::steady_clock::time_point t0;
+};
+
+// Runs one repetition of size n and returns the number of work items done
+typedef function<long (long n, Stopwatch& sw)> benchFunction;
+
+struct BenchCase {
+    const char* name;           // group/case
+    const char* unit;
+    long max_n;
+    benchFunction run;
+    double T;                   // transmissibility, for simulators that have one; 0 if not
+
+    BenchCase(const char* name, const char* unit, long max_n, benchFunction run, double T = 0)
+        : name(name), unit(unit), max_n(max_n), run(run), T(T) {}
+};
+
+long edge_count(Network& net) { return (long) (net.mean_deg() * net.size() / 2 + 0.5); }
+
+// A Poisson(MEAN_DEGREE) configuration model network
+void poisson_network(Network& net, long n, double lambda = MEAN_DEGREE) {
+    net.populate(n);
+    net.rand_connect_poisson(lambda);
+}
+
+BenchCase generator(const char* name, function<bool (Network&, long)> generate, long max_n) {
+    BenchCase c = {name, "edges", max_n, [generate](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        sw.start();
+        generate(net, n);
+        sw.stop();
+        return edge_count(net);
+    }};
+    return c;
+}
+
+vector<BenchCase> all_cases() {
+    vector<BenchCase> cases;
+
+    // Generators
+    cases.push_back(generator("generate/erdos_renyi",
+        [](Network& net, long n) { net.populate(n); return net.erdos_renyi(MEAN_DEGREE); }, 10000));
+    cases.push_back(generator("generate/sparse_random_graph",
+        [](Network& net, long n) { net.populate(n); return net.sparse_random_graph(MEAN_DEGREE); }, 10000000));
+    cases.push_back(generator("generate/config_poisson",
+        [](Network& net, long n) { net.populate(n); return net.rand_connect_poisson(MEAN_DEGREE); }, 10000000));
+    cases.push_back(generator("generate/config_powerlaw",
+        [](Network& net, long n) { net.populate(n); return net.rand_connect_powerlaw(2.0, 100); }, 10000000));
+    cases.push_back(generator("generate/config_exponential",
+        [](Network& net, long n) { net.populate(n); return net.rand_connect_exponential(0.2); }, 10000000));
+    cases.push_back(generator("generate/ring_lattice",
+        [](Network& net, long n) { return net.ring_lattice(n, MEAN_DEGREE / 2); }, 10000000));
+    cases.push_back(generator("generate/square_lattice",
+        [](Network& net, long n) { const int side = (int) (sqrt((double) n) + 0.5); return net.square_lattice(side, side, false); }, 10000000));
+    cases.push_back(generator("generate/small_world",
+        [](Network& net, long n) { return net.small_world(n, MEAN_DEGREE / 2, 0.1); }, 10000000));
+
+    // Stubs matched at random, as in rand_connect_stubs(), but without its
+    // call to lose_loops(), which is what is timed
+    cases.push_back({"network/lose_loops", "edges", 10000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        net.populate(n);
+        poisson_distribution<int> degree(MEAN_DEGREE);
+        vector<Node*> nodes = net.get_nodes();
+        long stub_ct = 0;
+        for (long i = 0; i < n; i++) {
+            int k = degree(*net.get_rng());
+            if (i == n - 1 and (stub_ct + k) % 2) k++;
+            nodes[i]->add_stubs(k);
+            stub_ct += k;
+        }
+        vector<Edge*> stubs = net.get_edges();
+        shuffle(stubs, net.get_rng());
+        for (unsigned int i = 0; i + 1 < stubs.size(); i += 2) {
+            stubs[i]->define_end(stubs[i+1]->get_start());
+            stubs[i+1]->define_end(stubs[i]->get_start());
+        }
+        sw.start();
+        net.lose_loops();
+        sw.stop();
+        return stub_ct / 2;
+    }});
+
+    // Analyses, on Poisson networks
+    cases.push_back({"network/components", "nodes", 10000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n, 1.5);   // many components
+        sw.start();
+        net.get_components();
+        sw.stop();
+        return n;
+    }});
+    cases.push_back({"network/k_shell", "nodes", 1000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n);
+        sw.start();
+        net.k_shell_decomposition();
+        sw.stop();
+        return n;
+    }});
+    cases.push_back({"network/transitivity", "nodes", 1000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n);
+        sw.start();
+        net.transitivity();
+        sw.stop();
+        return n;
+    }});
+    cases.push_back({"network/mean_dist", "node pairs", 1000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n);
+        sw.start();
+        net.mean_dist();
+        sw.stop();
+        return n * (n - 1) / 2;
+    }});
+
+    // Simulators.  Each runs until its epidemic is over, and counts the
+    // infections it simulated.
+    cases.push_back({"simulate/percolation", "infections", 10000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n);
+        Percolation_Sim sim(&net);
+        sim.set_transmissibility(PERCOLATION_T);
+        sw.start();
+        sim.rand_infect(10);
+        sim.run_simulation();
+        sw.stop();
+        return sim.epidemic_size();
+    }, PERCOLATION_T});
+    cases.push_back({"simulate/chain_binomial", "infections", 10000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n);
+        ChainBinomial_Sim sim(&net, 5, CHAIN_BINOMIAL_T);
+        sw.start();
+        sim.rand_infect(10);
+        sim.run_simulation();
+        sw.stop();
+        return sim.epidemic_size();
+    }, CHAIN_BINOMIAL_T});
+    cases.push_back({"simulate/gillespie_network_seirs", "events", 10000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n);
+        Gillespie_Network_SEIRS_Sim sim(&net, 1.0/2.0, 1.0/3.0, 1.0/6.0, 365);
+        sim.rng.seed(Network::rng());
+        sim.set_contact_mode(Gillespie_Network_SEIRS_Sim::NEXT_REACTION);
+        long events = 0;
+        sw.start();
+        sim.rand_infect(10);
+        while (sim.next_event()) events++;  // not run_simulation(), which prints each day
+        sw.stop();
+        return events;
+    }});
+    cases.push_back({"simulate/gillespie_mass_action", "infections", 10000000, [](long n, Stopwatch& sw) {
+        Gillespie_MassAction_Sim sim(n, 1.0/6.0, 1.5/6.0);
+        sim.rng.seed(Network::rng());
+        sw.start();
+        sim.rand_infect(10);
+        sim.run_simulation();
+        sw.stop();
+        return sim.epidemic_size();
+    }});
+    cases.push_back({"simulate/gillespie_mass_action_counts", "infections", 10000000, [](long n, Stopwatch& sw) {
+        Gillespie_MassAction_Sim sim(n, 1.0/6.0, 1.5/6.0);
+        sim.set_engine(Gillespie_MassAction_Sim::COMPARTMENT_COUNTS);
+        sim.rng.seed(Network::rng());
+        sw.start();
+        sim.rand_infect(10);
+        sim.run_simulation();
+        sw.stop();
+        return sim.epidemic_size();
+    }});
+    // n is the number of days integrated
+    cases.push_back({"simulate/ode_sir", "days", 10000000, [](long n, Stopwatch& sw) {
+        SIR sim(1.5/6.0, 1.0/6.0);
+        sim.initialize(1.0 - 1e-4, 1e-4, 0.0);
+        sw.start();
+        for (long day = 0; day < n; day++) sim.step_simulation(1);
+        sw.stop();
+        return n;
+    }});
+    // n is the number of patches, on a ring, each mixing with its 10 nearest
+    // neighbours; 100 days are integrated
+    cases.push_back({"simulate/ode_metapopulation", "patch-days", 1000000, [](long n, Stopwatch& sw) {
+        const int P = n;
+        vector<int> offsets(1, 0), cols;
+        vector<double> values, N(P, 10000);
+        for (int p = 0; p < P; p++) {
+            for (int d = -5; d <= 5; d++) {
+                cols.push_back(((p + d) % P + P) % P);
+                values.push_back(d == 0 ? 0.9 : 0.01);
+            }
+            offsets.push_back(cols.size());
+        }
+        Metapopulation_SEIR_Sim sim(P, 1, 0.3, 0.5, 0.2);
+        sim.set_mobility_matrix(offsets, cols, values);
+        sim.initialize(N);
+        sim.infect(0, 0, 10);
+        sw.start();
+        sim.step_simulation(100);
+        sw.stop();
+        return 100 * n;
+    }});
+
+    // Edge list I/O
+    cases.push_back({"io/write_edgelist", "edges", 10000000, [](long n, Stopwatch& sw) {
+        Network net("bench", Network::Undirected);
+        poisson_network(net, n);
+        const string filename = "epifire_bench_" + to_string(getpid()) + ".csv";
+        sw.start();
+        net.write_edgelist(filename, Network::NodeIDs);
+        sw.stop();
+        remove(filename.c_str());
+        return edge_count(net);
+    }});
+    cases.push_back({"io/read_edgelist", "edges", 10000000, [](long n, Stopwatch& sw) {
+        const string filename = "epifire_bench_" + to_string(getpid()) + ".csv";
+        long edges = 0;
+        {
+            Network net("bench", Network::Undirected);
+            poisson_network(net, n);
+            net.write_edgelist(filename, Network::NodeIDs);
+            edges = edge_count(net);
+        }
+        Network net("bench", Network::Undirected);
+        sw.start();
+        net.read_edgelist(filename, ',', false);
+        sw.stop();
+        remove(filename.c_str());
+        return edges;
+    }});
+
+    return cases;
+}
+
+string json_string(const string& s) {
+    string q = "\"";
+    for (unsigned int i = 0; i < s.size(); i++) {
+        if (s[i] == '"' or s[i] == '\\') q += '\\';
+        q += s[i];
+    }
+    return q + "\"";
+}
+
+// Runs every repetition of one case and size; returns false if the next size
+// would probably take longer than the time limit
+bool run_case(const BenchCase& c, long n, int reps, double limit, string& json) {
+    int fd[2];
+    if (pipe(fd) != 0) { perror("pipe"); exit(1); }
+    cout.flush();
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(fd[0]);
+        if (not freopen("/dev/null", "w", stdout)) _exit(1);  // some library code prints as it goes
+        vector<double> times;
+        double items = 0;
+        for (int r = 0; r < reps; r++) {
+            Network::seed(12345 + r);
+            Stopwatch sw;
+            items += c.run(n, sw);
+            times.push_back(sw.seconds);
+            if (sw.seconds > limit) break;  // don't wait for the rest
+        }
+        ostringstream out;
+        out << setprecision(9) << times.size() << " " << items / times.size();
+        for (unsigned int i = 0; i < times.size(); i++) out << " " << times[i];
+        const string s = out.str();
+        if (write(fd[1], s.c_str(), s.size()) < 0) _exit(1);
+        _exit(0);
+    }
+    close(fd[1]);
+    string result;
+    char buffer[4096];
+    ssize_t len;
+    while ((len = read(fd[0], buffer, sizeof(buffer))) > 0) result.append(buffer, len);
+    close(fd[0]);
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if (not WIFEXITED(status) or WEXITSTATUS(status) != 0 or result.empty()) {
+        cerr << "  " << c.name << " n=" << n << " failed" << endl;
+        return false;
+    }
+
+    istringstream in(result);
+    int count;
+    double items;
+    in >> count >> items;
+    vector<double> times(count);
+    for (int i = 0; i < count; i++) in >> times[i];
+    const double median_s = median(times);
+
+    ostringstream out;
+    out << setprecision(6)
+        << "    {\"name\": " << json_string(c.name) << ", \"n\": " << n;
+    if (c.T > 0) out << ", \"T\": " << c.T;
+    out << ", \"unit\": " << json_string(c.unit) << ", \"items\": " << (long) (items + 0.5)
+        << ", \"reps\": " << count << ", \"wall_s\": [";
+    for (int i = 0; i < count; i++) out << (i ? ", " : "") << times[i];
+    out << "], \"median_s\": " << median_s
+        << ", \"throughput\": " << (median_s > 0 ? items / median_s : 0)
+        << ", \"peak_rss_kb\": " << usage.ru_maxrss << "}";
+    json = out.str();
+
+    cerr << "  " << left << setw(40) << c.name << right << setw(10) << n
+         << setw(12) << median_s << " s" << setw(14) << (median_s > 0 ? items / median_s : 0) << " " << c.unit << "/s"
+         << setw(10) << usage.ru_maxrss / 1024 << " MB" << endl;
+    return 10 * median_s <= limit;
+}
+
+int main(int argc, char* argv[]) {
+    int reps = 5;
+    long min_n = 1000, max_n = 100000;
+    double limit = 20;
+    string filter = "";
+    bool list = false;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--reps" and has_value) reps = atoi(argv[++i]);
+        else if (arg == "--min-size" and has_value) min_n = atol(argv[++i]);
+        else if (arg == "--max-size" and has_value) max_n = atol(argv[++i]);
+        else if (arg == "--time-limit" and has_value) limit = atof(argv[++i]);
+        else if (arg == "--filter" and has_value) filter = argv[++i];
+        else if (arg == "--list") list = true;
+        else {
+            cerr << "Usage: " << argv[0] << " [--reps R] [--min-size N] [--max-size N] [--time-limit S] [--filter TEXT] [--list]\n";
+            return 1;
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    vector<BenchCase> cases = all_cases();
+    if (list) {
+        for (unsigned int i = 0; i < cases.size(); i++) cout << cases[i].name << "\t" << cases[i].max_n << endl;
+        return 0;
+    }
+
+    char date[64];
+    const time_t now = time(0);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+
+    cout << "{\n  \"benchmark\": \"epifire_bench\",\n  \"date\": " << json_string(date)
+         << ",\n  \"host\": " << json_string(host) << ",\n  \"reps\": " << reps
+         << ",\n  \"results\": [";
+    bool first = true;
+    for (unsigned int i = 0; i < cases.size(); i++) {
+        const BenchCase& c = cases[i];
+        if (not filter.empty() and string(c.name).find(filter) == string::npos) continue;
+        for (long n = 1000; n <= max_n and n <= c.max_n; n *= 10) {
+            if (n < min_n) continue;
+            string json;
+            const bool in_time = run_case(c, n, reps, limit, json);
+            if (not json.empty()) {
+                cout << (first ? "\n" : ",\n") << json;
+                first = false;
+            }
+            if (not in_time) {
+                if (n * 10 <= max_n and n * 10 <= c.max_n) cerr << "  (skipping larger sizes of " << c.name << ")" << endl;
+                break;
+            }
+        }
+    }
+    cout << "\n  ]\n}" << endl;
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "Hybrid_MassAction_Sim.h"
+#include <time.h>
+
+// Compares the exact, tau-leaping and hybrid SSA/ODE engines for the
+// mass-action SIR model.  Starting from a single infection, the chance of early
+// extinction (1/R0) should agree, as should the final size of major epidemics.
+
+void report(string name, vector<int> sizes, int N, double seconds) {
+    vector<int> major;
+    for (unsigned int i = 0; i < sizes.size(); i++) if (sizes[i] > 0.01 * N) major.push_back(sizes[i]);
+    cout << name << "\tP(minor outbreak): " << 1.0 - (double) major.size() / sizes.size()
+         << "\tmean major size: " << (major.size() > 0 ? mean(major) : 0)
+         << "\tseconds: " << seconds << endl;
+}
+
+int main() {
+    const int N       = 1000000;
+    const int reps    = 200;
+    const double GAMMA = 1/(double) 6;
+    const double BETA  = 1/(double) 4;   // R0 = 1.5
+
+    for (int e = 0; e < 2; e++) {
+        vector<int> sizes;
+        clock_t start = clock();
+        for (int i = 0; i < reps; i++) {
+            Gillespie_MassAction_Sim sim(N, GAMMA, BETA);
+            sim.set_engine(e == 0 ? Gillespie_MassAction_Sim::COMPARTMENT_COUNTS : Gillespie_MassAction_Sim::TAU_LEAPING);
+            sim.rng.seed(i);
+            sim.rand_infect(1);
+            sim.run_simulation();
+            sizes.push_back(sim.epidemic_size());
+        }
+        report(e == 0 ? "exact" : "tau-leaping", sizes, N, ((double) clock() - start) / CLOCKS_PER_SEC);
+    }
+
+    vector<int> sizes;
+    clock_t start = clock();
+    for (int i = 0; i < reps; i++) {
+        Hybrid_MassAction_Sim sim(N, GAMMA, BETA);
+        sim.rng.seed(i);
+        sim.rand_infect(1);
+        sim.run_simulation();
+        sizes.push_back(sim.epidemic_size());
+    }
+    report("hybrid", sizes, N, ((double) clock() - start) / CLOCKS_PER_SEC);
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "Batch_DiffEq_Sim.h"
+#include <chrono>
+
+// Integrates the SIR equations over a grid of (beta, gamma) values, once with a
+// reused SIR instance stepped a day at a time, and once with Batch_DiffEq_Sim,
+// and compares the time taken and the daily prevalence.  Then does the same
+// comparison, for correctness only, with the network SIR model.
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    const int grid = 100;       // grid x grid parameter sets
+    const int days = 200;
+    const double I0 = 1.0/10000;
+
+    vector<double> params, y0, times;
+    for (int i = 0; i < grid; i++) {
+        for (int j = 0; j < grid; j++) {
+            params.push_back(0.15 + 0.35 * i / grid);      // beta
+            params.push_back(1.0 / (3.0 + 7.0 * j / grid)); // gamma
+            y0.push_back(1.0 - I0); y0.push_back(I0); y0.push_back(0.0);
+        }
+    }
+    for (int d = 1; d <= days; d++) times.push_back(d);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<double> serial;
+    SIR sim;
+    for (int s = 0; s < grid * grid; s++) {
+        sim.set_parameters(params[2*s], params[2*s + 1]);
+        sim.initialize(y0[3*s], y0[3*s + 1], y0[3*s + 2]);
+        for (int d = 1; d <= days; d++) {
+            sim.step_simulation(1.0);
+            serial.push_back(sim.y[1]);
+        }
+    }
+    cout << "DiffEq_Sim, one set at a time: " << seconds_since(start) << " s" << endl;
+
+    Batch_DiffEq_Sim<SIR> batch;
+    for (int threads = 1; threads <= (int) thread::hardware_concurrency(); threads *= 2) {
+        batch.set_num_threads(threads);
+        start = chrono::steady_clock::now();
+        batch.run(params, y0, times);
+        cout << "Batch_DiffEq_Sim, " << threads << " thread(s): " << seconds_since(start) << " s" << endl;
+    }
+
+    double max_diff = 0;
+    for (int s = 0; s < grid * grid; s++) {
+        for (int d = 0; d < days; d++) max_diff = MAX(max_diff, fabs(batch.get(s, d, 1) - serial[s * days + d]));
+    }
+    cout << "largest difference in daily prevalence: " << max_diff << endl;
+
+    // The network model, on a power-law degree distribution reaching degree
+    // 100,000, for a handful of (r, mu) values
+    const vector<double> deg_dist = gen_trunc_powerlaw(2.5, 100000, 1, 100000);
+    const int net_sets = 8, net_days = 100;
+    vector<double> net_params, net_y0, net_times;
+    for (int s = 0; s < net_sets; s++) {
+        net_params.push_back(0.05 + 0.05 * s);             // r
+        net_params.push_back(0.2);                          // mu
+        net_y0.push_back(1.0); net_y0.push_back(1.0 - I0); net_y0.push_back(I0); net_y0.push_back(I0);
+    }
+    for (int d = 1; d <= net_days; d++) net_times.push_back(d);
+
+    const Batch_Kernel<Deterministic_Network_SIR_Sim> kernel(deg_dist);
+    Batch_DiffEq_Sim<Deterministic_Network_SIR_Sim> net_batch(kernel);
+    net_batch.run(net_params, net_y0, net_times);
+
+    max_diff = 0;
+    Deterministic_Network_SIR_Sim net_sim;
+    for (int s = 0; s < net_sets; s++) {
+        net_sim.set_parameters(net_params[2*s], net_params[2*s + 1], deg_dist);
+        net_sim.initialize(net_y0[4*s], net_y0[4*s + 1], net_y0[4*s + 2], net_y0[4*s + 3]);
+        for (int d = 0; d < net_days; d++) {
+            net_sim.step_simulation(1.0);
+            max_diff = MAX(max_diff, fabs(net_batch.get(s, d, 3) - net_sim.y[3]));
+        }
+    }
+    cout << "network model, largest difference in daily prevalence: " << max_diff << endl;
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "SIR_Sim.h"
+#include <chrono>
+
+// Frequent output, the epidemic peak, and the end of the epidemic from a single
+// integration, compared with stepping the simulator one output interval at a
+// time and watching for the peak and the end ourselves.  Tolerances are
+// tightened for both, since the default absolute tolerance (1e-5) is coarse for
+// fractions of the population, and would make the end of the epidemic late.
+// Last, a copy of the simulator finds the same events with the Rosenbrock
+// solver.
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    const double R0    = 1.5;
+    const double GAMMA = 1.0/6.0;
+    const double BETA  = R0 * GAMMA;
+    const double I0    = 1.0/10000;
+    const double DT    = 0.01;          // output interval, in days
+    const double TMAX  = 2000;
+    const int    REPS  = 100;
+
+    vector<double> times;
+    for (int i = 1; i * DT <= TMAX; i++) times.push_back(i * DT);
+
+    SIR sim(BETA, GAMMA);
+    sim.set_tolerances(1e-12, 1e-10);
+    sim.add_peak_event(1);                              // I reaches its maximum
+    sim.add_threshold_event(1, 0.1 * I0, -1, true);     // I falls below a tenth of I0; stop
+
+    vector< vector<double> > output;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < REPS; r++) {
+        sim.initialize(1.0 - I0, I0, 0.0);
+        sim.run_simulation(TMAX, times, output);
+    }
+    const double dense_seconds = seconds_since(start) / REPS;
+
+    const vector<DiffEq_Sim::ODE_Event_Record>& events = sim.get_event_log();
+    for (unsigned int e = 0; e < events.size(); e++) {
+        cout << (events[e].event == 0 ? "peak" : "end ") << " at day " << events[e].time
+             << ": S = " << events[e].state[0] << ", I = " << events[e].state[1] << ", R = " << events[e].state[2] << endl;
+    }
+    cout << "dense output: " << output.size() << " outputs, " << dense_seconds << " s" << endl;
+
+    // the old way: one step_simulation() call per output time
+    SIR stepped(BETA, GAMMA);
+    stepped.set_tolerances(1e-12, 1e-10);
+    double peak = 0, peak_day = 0, max_err = 0;
+    int n = 0;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < REPS; r++) {
+        stepped.initialize(1.0 - I0, I0, 0.0);
+        peak = 0; n = 0; max_err = 0;
+        while (stepped.y[1] > 0.1 * I0) {
+            stepped.step_simulation(DT);
+            if (stepped.y[1] > peak) { peak = stepped.y[1]; peak_day = stepped.get_time(); }
+            if (n < (int) output.size()) max_err = max(max_err, fabs(stepped.y[1] - output[n][1]));
+            n++;
+        }
+    }
+    const double stepped_seconds = seconds_since(start) / REPS;
+    cout << "stepped:      " << n << " outputs, " << stepped_seconds << " s, peak on day " << peak_day
+         << ", largest difference in I " << max_err << endl;
+    cout << "speedup:      " << stepped_seconds / dense_seconds << endl;
+
+    // the same events with the implicit solver, on a copy, which keeps them
+    SIR implicit(sim);
+    implicit.set_solver(DiffEq_Sim::ROSENBROCK);
+    implicit.initialize(1.0 - I0, I0, 0.0);
+    implicit.run_simulation(TMAX, times, output);
+    const vector<DiffEq_Sim::ODE_Event_Record>& implicit_events = implicit.get_event_log();
+    if (implicit_events.size() != events.size()) {
+        cout << "Rosenbrock found " << implicit_events.size() << " events, not " << events.size() << endl;
+        return 1;
+    }
+    for (unsigned int e = 0; e < implicit_events.size(); e++) {
+        cout << "Rosenbrock:   " << (implicit_events[e].event == 0 ? "peak" : "end ") << " at day " << implicit_events[e].time
+             << " (" << implicit_events[e].time - events[e].time << " from RKF45)" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "Louvain.h"
+#include <chrono>
+
+// Louvain community detection, first on a small planted-partition network
+// built with Network (to see how well the planted groups are recovered), and
+// then on Adjacency snapshots built directly, to show how the running time
+// scales.  The largest has 10^6 nodes by default; for 10^7 nodes (about 2 GB),
+// run
+//
+//      ./ex14_communities 10000000
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Groups of size s; each node has about k_in neighbors in its own group and
+// k_out elsewhere.  (No edge costs, since they won't be used.)
+void planted_partition(Adjacency& adj, int n, int s, double k_in, double k_out, mt19937& rng) {
+    const long internal = (long) (n * k_in / 2), external = (long) (n * k_out / 2);
+    vector<int> start, end;
+    start.reserve(internal + external);
+    end.reserve(internal + external);
+    for (long e = 0; e < internal + external; e++) {
+        const int i = rand_uniform_int(0, n - 1, &rng);
+        const int j = e < internal ? (i / s) * s + rand_uniform_int(0, s - 1, &rng) : rand_uniform_int(0, n - 1, &rng);
+        if (i == j) continue;
+        start.push_back(i);
+        end.push_back(j);
+    }
+    adj.offsets.assign(n + 1, 0);
+    for (unsigned int e = 0; e < start.size(); e++) { adj.offsets[ start[e] + 1 ]++; adj.offsets[ end[e] + 1 ]++; }
+    for (int i = 0; i < n; i++) adj.offsets[i+1] += adj.offsets[i];
+    adj.neighbors.resize(adj.offsets[n]);
+    vector<int> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+    for (unsigned int e = 0; e < start.size(); e++) {
+        adj.neighbors[ fill[ start[e] ]++ ] = end[e];
+        adj.neighbors[ fill[ end[e] ]++ ] = start[e];
+    }
+    adj.costs.clear();
+    adj.nodes.assign(n, NULL);
+}
+
+// fraction of pairs of nodes in the same planted group that are in the same community
+double recovered(const vector<int>& labels, int s) {
+    long same = 0, pairs = 0;
+    for (unsigned int g = 0; g < labels.size(); g += s) {
+        for (int a = 0; a < s; a++) for (int b = a + 1; b < s; b++) {
+            same += labels[g + a] == labels[g + b];
+            pairs++;
+        }
+    }
+    return (double) same / pairs;
+}
+
+int main(int argc, char* argv[]) {
+    const int max_n = argc > 1 ? atoi(argv[1]) : 1000000;
+    const int S = 50;   // planted group size
+
+    // Network: groups of 50 nodes, each node with about 8 neighbors inside its
+    // group and 2 outside; edges inside groups cost 3 and between groups 1
+    Network net("planted", Network::Undirected);
+    Network::seed(1);
+    mt19937 rng(1);
+    net.populate(5000);
+    vector<Node*> nodes = net.get_nodes();
+    for (int e = 0; e < 5000 * 5; e++) {
+        const int i = rand_uniform_int(0, 4999, &rng);
+        const int j = e % 5 < 4 ? (i / S) * S + rand_uniform_int(0, S - 1, &rng) : rand_uniform_int(0, 4999, &rng);
+        if (i == j or nodes[i]->is_neighbor(nodes[j])) continue;
+        nodes[i]->connect_to(nodes[j]);
+    }
+    for (Edge* edge: net.get_edges()) {
+        const int i = edge->get_start()->get_id(), j = edge->get_end()->get_id();
+        edge->set_cost(i / S == j / S ? 3.0 : 1.0);
+    }
+
+    for (int weighted = 0; weighted < 2; weighted++) {
+        Louvain louvain(&net, weighted);
+        louvain.run();
+        cout << (weighted ? "edge costs as weights: " : "unweighted:            ") << louvain.num_communities()
+             << " communities, modularity " << louvain.get_modularity()
+             << ", planted pairs together " << recovered(louvain.get_labels(), S) << endl;
+    }
+
+    // bigger networks, built straight into Adjacency
+    cout << endl << "nodes\tedges\tthreads\tlevels\tcommunities\tmodularity\trecovered\tseconds" << endl;
+    for (int n = 1000; n <= max_n; n *= 10) {
+        Adjacency adj;
+        planted_partition(adj, n, S, 8, 2, rng);
+        const int max_threads = MAX(1, (int) thread::hardware_concurrency());
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            Louvain louvain(adj, false, false, threads);
+            louvain.run();
+            cout << n << "\t" << adj.num_edges() / 2 << "\t" << threads << "\t" << louvain.num_levels() << "\t"
+                 << louvain.num_communities() << "\t" << louvain.get_modularity() << "\t"
+                 << recovered(louvain.get_labels(), S) << "\t" << seconds_since(start) << endl;
+        }
+    }
+    return 0;
+}
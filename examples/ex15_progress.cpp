@@ -0,0 +1,74 @@
+#include "Network.h"
+#include <thread>
+#include <chrono>
+#include <iomanip>
+
+// Following a long network job from another thread.  A Poisson network is
+// generated, and its components and transitivity calculated, on a worker
+// thread, while the main thread polls the Progress the network reports to and
+// prints each phase, how far along it is and about how long it has left.  With
+// a time limit, the job is cancelled once the limit is reached.
+//
+//      ./ex15_progress [nodes] [mean degree] [time limit (s)]
+//
+// The defaults are 10^6 nodes, mean degree 10, and no time limit.
+
+int main(int argc, char* argv[]) {
+    const int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    const double lambda = argc > 2 ? atof(argv[2]) : 10;
+    const double limit = argc > 3 ? atof(argv[3]) : 0;
+
+    Network net("progress", Network::Undirected);
+    Progress progress;
+    net.set_progress(&progress);
+
+    atomic<bool> done(false);
+    bool connected = false;
+    int components = 0;
+    double transitivity = 0;
+    thread worker([&]() {
+        net.populate(n);
+        connected = net.rand_connect_poisson(lambda);
+        if (connected) components = net.get_components().size();
+        if (connected and not progress.cancelled()) transitivity = net.transitivity();
+        done = true;
+    });
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int phase = 0;
+    while (true) {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        const bool finished = done;    // read before printing, so the last state is shown
+        if (progress.phase() != phase) {
+            if (phase > 0) cerr << endl;
+            phase = progress.phase();
+        }
+        if (phase > 0) {
+            cerr << "\r" << setw(40) << left << progress.phase_name() << right
+                 << setw(4) << (int) (100 * progress.fraction()) << "%";
+            const double eta = progress.eta();
+            if (eta >= 0) cerr << "   about " << setw(5) << (int) (eta + 0.5) << " s left";
+            cerr << "      " << flush;
+        }
+        const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (limit > 0 and elapsed > limit and not progress.cancelled()) {
+            cerr << endl << "Time limit reached; cancelling";
+            progress.cancel();
+        }
+        if (finished) break;
+    }
+    worker.join();
+    cerr << endl;
+
+    if (progress.cancelled()) {
+        cout << "Cancelled" << endl;
+    } else if (not connected) {
+        cout << "Could not generate the network" << endl;
+    } else {
+        cout << "Nodes: " << net.size() << endl;
+        cout << "Mean degree: " << net.mean_deg() << endl;
+        cout << "Components: " << components << endl;
+        cout << "Transitivity: " << transitivity << endl;
+    }
+    return 0;
+}
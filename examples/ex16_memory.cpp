@@ -0,0 +1,33 @@
+#include "Network.h"
+#include <sys/resource.h>
+
+// Predicting how much memory a network will need before building it.  The
+// estimate for a Poisson network is printed, and the network is only
+// generated if its peak fits in the budget; then what it actually holds is
+// printed, along with the process's peak resident memory for comparison.
+//
+//      ./ex16_memory [nodes] [mean degree] [budget (MB)]
+//
+// The defaults are 10^6 nodes, mean degree 10, and a budget of 2048 MB.
+
+int main(int argc, char* argv[]) {
+    const int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    const double lambda = argc > 2 ? atof(argv[2]) : 10;
+    const double budget_mb = argc > 3 ? atof(argv[3]) : 2048;
+
+    cout << "Estimated:\n" << Network::estimate_memory(n, lambda) << endl;
+
+    Network net("memory", Network::Undirected);
+    net.set_memory_budget(budget_mb * 1048576);
+    if (not net.populate(n) or not net.rand_connect_poisson(lambda)) {
+        cout << "Not generated" << endl;
+        return 1;
+    }
+
+    cout << "Actual:\n" << net.memory_usage() << endl;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    cout << "Peak resident memory: " << usage.ru_maxrss * 1024L << " bytes" << endl;
+    return 0;
+}
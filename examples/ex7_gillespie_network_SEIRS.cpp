@@ -15,6 +15,7 @@ int main() {
     for(int i=0; i<1; i++ ) {
         Gillespie_Network_SEIRS_Sim sim(&net, mu, beta, gamma, immunity_duration);
         sim.rng.seed(time(0)); // this simulator has its own RNG which must be seeded as well
+        sim.set_contact_mode(Gillespie_Network_SEIRS_Sim::NEXT_REACTION); // keeps the event queue small
         sim.rand_infect(1);
         sim.run_simulation(1000);
         //cout << sim.current_epidemic_size() << endl;
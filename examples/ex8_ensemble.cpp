@@ -0,0 +1,32 @@
+#include <Ensemble.h>
+
+// This example runs many replicates of the same chain binomial epidemic in
+// parallel.  All threads share one copy of the network topology; each keeps
+// its own node states and random number generator, so the results depend
+// only on the seed passed to ens.seed().
+
+int main() {
+    // Construct Network
+    Network net("name", Network::Undirected);
+    Network::seed(); //seed RNG (can pass in a custom seed)
+    net.populate(10000);
+    net.rand_connect_poisson(5);
+
+    // Simulation parameters
+    int infectious_period = 10;
+    double T = 0.05;
+    int reps = 1000;
+
+    Ensemble ens(&net); // uses one thread per core by default
+    ens.seed(1234);
+    ens.run_chain_binomial(reps, infectious_period, T, 1);
+
+    vector<int> sizes = ens.get_epidemic_sizes();
+    for (int i = 0; i < reps; i++) cout << sizes[i] << endl;
+
+    // Percolation and Gillespie SEIRS replicates work the same way
+    ens.run_percolation(reps, 0.25, 10);
+    ens.run_gillespie_SEIRS(reps, 1.0/2.0, 1.0/3.0, 1.0/6.0, 365, 1000, 1);
+
+    return 0;
+}
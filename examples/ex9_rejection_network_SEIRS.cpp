@@ -0,0 +1,26 @@
+#include "Rejection_Network_SEIRS_Sim.h"
+
+// Same model as ex7_gillespie_network_SEIRS, using the queue-free simulator.
+// Each event costs O(1), which matters for long endemic runs on big networks.
+
+int main() { 
+
+    Network net = Network("gillespie toy", Network::Undirected);
+    Network::seed(); //seed RNG (can pass in a custom seed)
+    net.populate(10000);
+    net.fast_random_graph(8);
+
+    double mu    = 1.0/2.0; // E -> I transition rate
+    double beta  = 1.0/3.0; // contact rate
+    double gamma = 1.0/6.0; // I -> R transition rate
+    double immunity_duration = 365;
+
+    for(int i=0; i<1; i++ ) {
+        Rejection_Network_SEIRS_Sim sim(&net, mu, beta, gamma, immunity_duration);
+        sim.rng.seed(time(0)); // this simulator has its own RNG which must be seeded as well
+        sim.rand_infect(1);
+        sim.run_simulation(1000);
+    }
+
+    return 0;
+}
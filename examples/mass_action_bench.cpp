@@ -0,0 +1,64 @@
+#include "Gillespie_MassAction_Sim.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <time.h>
+
+// Times Gillespie_MassAction_Sim with each of its engines as the population grows.
+// Each run happens in a child process, so that the peak resident set size
+// reported for it isn't inflated by earlier (larger) runs.
+//
+// Output is one line per run:
+//   engine  N  epidemic_size  steps  seconds  steps/sec  peak_RSS_MB
+// (a tau-leaping step covers many events)
+
+void bench(Gillespie_MassAction_Sim::engineType engine, int N) {
+    const double GAMMA = 1/(double) 6;
+    const double BETA  = 1/(double) 4;
+    Gillespie_MassAction_Sim sim(N, GAMMA, BETA);
+    sim.set_engine(engine);
+    sim.rng.seed(N);
+    sim.rand_infect(100);
+
+    long events = 0;
+    size_t max_queue = 0;
+    clock_t start = clock();
+    while (sim.next_event()) {
+        events++;
+        max_queue = MAX(max_queue, sim.EventQ.size());
+    }
+    double elapsed = ((double) clock() - start) / CLOCKS_PER_SEC;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    double peak_mb = usage.ru_maxrss / (1024.0 * 1024.0); // bytes on OS X
+#else
+    double peak_mb = usage.ru_maxrss / 1024.0;            // kilobytes on Linux
+#endif
+
+    const char* names[] = {"event_queue", "compartment_counts", "tau_leaping"};
+    cout << names[engine] << "\t"
+         << N << "\t" << sim.epidemic_size() << "\t" << events << "\t" << elapsed << "\t"
+         << events / elapsed << "\t" << peak_mb << "\t(max queue: " << max_queue << ")" << endl;
+}
+
+int main(int argc, char** argv) {
+    // Event queue runs get slow (and big) quickly, so they stop sooner by default
+    int max_queue_N = argc > 1 ? atoi(argv[1]) : 10000000;
+    int max_count_N = argc > 2 ? atoi(argv[2]) : 100000000;
+
+    for (int N = 10000; N <= max_count_N; N *= 10) {
+        for (int e = 0; e < 3; e++) {
+            Gillespie_MassAction_Sim::engineType engine = (Gillespie_MassAction_Sim::engineType) e;
+            if (engine == Gillespie_MassAction_Sim::EVENT_QUEUE and N > max_queue_N) continue;
+            pid_t pid = fork();
+            if (pid == 0) {
+                bench(engine, N);
+                return 0;
+            }
+            waitpid(pid, NULL, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "Metapopulation_SEIR_Sim.h"
+#include <chrono>
+
+// Throughput of Metapopulation_SEIR_Sim::derivative() as the number of patches
+// grows, with 1 and 16 age groups per patch:
+//
+//   loops   -- the same force of infection written as nested loops
+//   dense   -- dense mobility matrix, through CBLAS
+//   sparse  -- the same mobility matrix in CSR form
+//
+// Each patch keeps 90% of its contacts at home and splits the rest among its
+// 10 nearest neighbours on a ring.  The force of infection from each mode is
+// checked against the loops.
+
+class Looped_SEIR : public Metapopulation_SEIR_Sim {
+    public:
+        Looped_SEIR(int patches, int groups, const vector<double>& C, const vector<double>& M)
+            : Metapopulation_SEIR_Sim(patches, groups, BETA, SIGMA, GAMMA), P(patches), A(groups), C(C), M(M) {}
+
+        static constexpr double BETA = 0.3, SIGMA = 0.5, GAMMA = 0.2;
+        int P, A;
+        vector<double> C, M, N, lambda;
+
+        void derivative(double const y[], double dydt[]) {
+            const int n = P * A;
+            lambda.assign(n, 0.0);
+            for (int p = 0; p < P; p++) {
+                for (int a = 0; a < A; a++) {
+                    double force = 0;
+                    for (int q = 0; q < P; q++) {
+                        if (M[p*P + q] == 0) continue;
+                        double mixed = 0;
+                        for (int b = 0; b < A; b++) mixed += C[a*A + b] * y[2*n + q*A + b] / N[q*A + b];
+                        force += M[p*P + q] * mixed;
+                    }
+                    lambda[p*A + a] = BETA * force;
+                }
+            }
+            for (int x = 0; x < n; x++) {
+                const double infection = lambda[x] * y[x];
+                dydt[x]       = -infection;
+                dydt[n + x]   = infection - SIGMA * y[n + x];
+                dydt[2*n + x] = SIGMA * y[n + x] - GAMMA * y[2*n + x];
+                dydt[3*n + x] = GAMMA * y[2*n + x];
+            }
+        }
+};
+
+// derivative() calls per second, over at least a fifth of a second
+double throughput(DiffEq_Sim& sim, vector<double>& dydt) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    long calls = 0;
+    double seconds = 0;
+    while (seconds < 0.2) {
+        sim.derivative(sim.y, &dydt[0]);
+        calls++;
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    return calls / seconds;
+}
+
+double max_rel_diff(const vector<double>& a, const vector<double>& b) {
+    double d = 0;
+    for (unsigned int i = 0; i < a.size(); i++) d = max(d, fabs(a[i] - b[i]) / max(fabs(b[i]), 1e-300));
+    return d;
+}
+
+void bench(int P, int A) {
+    vector<double> C(A * A), M(P * P, 0.0), N(P * A), values;
+    vector<int> offsets(1, 0), cols;
+    for (int a = 0; a < A; a++) for (int b = 0; b < A; b++) C[a*A + b] = 1.0 / (1 + abs(a - b));
+    for (int p = 0; p < P; p++) {
+        M[p*P + p] = 0.9;
+        for (int d = 1; d <= 5; d++) {
+            M[p*P + (p + d) % P] += 0.01;
+            M[p*P + (p - d + P) % P] += 0.01;
+        }
+        for (int q = 0; q < P; q++) {
+            if (M[p*P + q] == 0) continue;
+            cols.push_back(q);
+            values.push_back(M[p*P + q]);
+        }
+        offsets.push_back(cols.size());
+    }
+    for (int x = 0; x < P * A; x++) N[x] = 1000 + 37 * (x % 101);
+
+    Looped_SEIR loops(P, A, C, M);
+    Metapopulation_SEIR_Sim dense(P, A, Looped_SEIR::BETA, Looped_SEIR::SIGMA, Looped_SEIR::GAMMA);
+    Metapopulation_SEIR_Sim sparse(P, A, Looped_SEIR::BETA, Looped_SEIR::SIGMA, Looped_SEIR::GAMMA);
+    dense.set_contact_matrix(C, true);
+    sparse.set_contact_matrix(C, true);
+    dense.set_mobility_matrix(M);
+    sparse.set_mobility_matrix(offsets, cols, values);
+
+    Metapopulation_SEIR_Sim* sims[] = {&loops, &dense, &sparse};
+    loops.N = N;
+    for (int s = 0; s < 3; s++) {
+        sims[s]->initialize(N);
+        for (int p = 0; p < P; p++) for (int a = 0; a < A; a++) sims[s]->infect(p, a, 1 + (p + a) % 7);
+    }
+
+    vector<double> dydt(4 * P * A);
+    const bool slow = (double) P * P * A > 2e8;
+    const double loop_rate = slow ? 0 : throughput(loops, dydt);
+    const double dense_rate = throughput(dense, dydt);
+    const double sparse_rate = throughput(sparse, dydt);
+
+    double err = 0;
+    if (not slow) {
+        err = max(max_rel_diff(dense.force_of_infection(), loops.lambda), max_rel_diff(sparse.force_of_infection(), loops.lambda));
+    } else {
+        err = max_rel_diff(sparse.force_of_infection(), dense.force_of_infection());
+    }
+
+    cout << P << "\t" << A << "\t" << 4 * P * A << "\t";
+    if (slow) cout << "-"; else cout << loop_rate;
+    cout << "\t" << dense_rate << "\t" << sparse_rate << "\t" << err << endl;
+}
+
+int main() {
+    cout << "patches\tgroups\tvariables\tloops/s\tdense/s\tsparse/s\tmax_rel_diff" << endl;
+    for (int A = 1; A <= 16; A *= 16) {
+        for (int P = 16; P <= 4096; P *= 4) bench(P, A);
+    }
+    return 0;
+}
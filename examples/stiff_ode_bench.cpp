@@ -0,0 +1,131 @@
+#include "DiffEq_Sim.h"
+#include <time.h>
+
+// Compares RKF45 with the Rosenbrock solver on a stiff SEIR model: the exposed
+// and infectious periods are split into m Erlang stages each, so stage
+// progression happens on a time scale of hours, while births and deaths play
+// out over decades.  Explicit solvers are limited by stability to steps of a
+// fraction of the fastest time scale for the whole run.  A little infection
+// from outside (iota) keeps the troughs between epidemics from going so deep
+// that I is lost below the error tolerance.
+//
+//   rkf45             -- the default solver
+//   rosenbrock_dense  -- Jacobian by finite differences, one column at a time
+//   rosenbrock_fd     -- finite differences, using the sparsity pattern
+//   rosenbrock_exact  -- analytic sparse Jacobian
+//
+// Each is compared to an RKF45 run with tight tolerances.
+
+class Staged_SEIR : public DiffEq_Sim {
+    public:
+        // variables: S, E_1 .. E_m, I_1 .. I_m, R
+        Staged_SEIR(int stages, double b, double s, double g, double m, double i) {
+            M = stages; beta = b; sigma = s; gamma = g; mu = m; iota = i;
+            nbins = 2*M + 2;
+            rhs_calls = 0;
+        }
+
+        int M;
+        double beta, sigma, gamma, mu, iota;
+        long rhs_calls;
+
+        int E(int j) { return 1 + j; }
+        int I(int j) { return 1 + M + j; }
+        int R() { return 2*M + 1; }
+
+        void initialize(double infected) {
+            init_state();
+            y[0] = 1.0 - infected;
+            y[ I(0) ] = infected;
+        }
+
+        void derivative(const double y[], double dydt[]) {
+            rhs_calls++;
+            double infectious = 0;
+            for (int j = 0; j < M; j++) infectious += y[ I(j) ];
+            const double infection = (beta * infectious + iota) * y[0];
+            const double es = M * sigma, ig = M * gamma;
+
+            dydt[0] = mu - infection - mu * y[0];
+            dydt[ E(0) ] = infection - (es + mu) * y[ E(0) ];
+            for (int j = 1; j < M; j++) dydt[ E(j) ] = es * y[ E(j-1) ] - (es + mu) * y[ E(j) ];
+            dydt[ I(0) ] = es * y[ E(M-1) ] - (ig + mu) * y[ I(0) ];
+            for (int j = 1; j < M; j++) dydt[ I(j) ] = ig * y[ I(j-1) ] - (ig + mu) * y[ I(j) ];
+            dydt[ R() ] = ig * y[ I(M-1) ] - mu * y[ R() ];
+        }
+
+        // The pattern, row by row, in the same order that jacobian() fills it in
+        void define_pattern(bool analytic) {
+            vector<int> offsets(1, 0), cols;
+            cols.push_back(0); for (int j = 0; j < M; j++) cols.push_back( I(j) );        // S
+            offsets.push_back(cols.size());
+            cols.push_back(0); cols.push_back( E(0) );                                   // E_1
+            for (int j = 0; j < M; j++) cols.push_back( I(j) );
+            offsets.push_back(cols.size());
+            for (int j = 1; j < M; j++) {                                                // E_j
+                cols.push_back( E(j-1) ); cols.push_back( E(j) );
+                offsets.push_back(cols.size());
+            }
+            cols.push_back( E(M-1) ); cols.push_back( I(0) );                            // I_1
+            offsets.push_back(cols.size());
+            for (int j = 1; j < M; j++) {                                                // I_j
+                cols.push_back( I(j-1) ); cols.push_back( I(j) );
+                offsets.push_back(cols.size());
+            }
+            cols.push_back( I(M-1) ); cols.push_back( R() );                             // R
+            offsets.push_back(cols.size());
+            set_jacobian_pattern(offsets, cols, analytic);
+        }
+
+        void jacobian(const double y[], double values[]) {
+            double infectious = 0;
+            for (int j = 0; j < M; j++) infectious += y[ I(j) ];
+            const double es = M * sigma, ig = M * gamma;
+            int e = 0;
+            values[e++] = -beta * infectious - iota - mu;
+            for (int j = 0; j < M; j++) values[e++] = -beta * y[0];
+            values[e++] = beta * infectious + iota;
+            values[e++] = -(es + mu);
+            for (int j = 0; j < M; j++) values[e++] = beta * y[0];
+            for (int j = 1; j < M; j++) { values[e++] = es; values[e++] = -(es + mu); }
+            values[e++] = es; values[e++] = -(ig + mu);
+            for (int j = 1; j < M; j++) { values[e++] = ig; values[e++] = -(ig + mu); }
+            values[e++] = ig; values[e++] = -mu;
+        }
+};
+
+double seconds_since(clock_t start) { return ((double) clock() - start) / CLOCKS_PER_SEC; }
+
+void bench(int stages, double years) {
+    const double BETA = 1.0, SIGMA = 1.0/2, GAMMA = 1.0/4, MU = 1.0/(70*365), IOTA = 1e-6; // per day
+    const double days = years * 365;
+
+    Staged_SEIR reference(stages, BETA, SIGMA, GAMMA, MU, IOTA);
+    reference.set_tolerances(1e-12, 1e-10);
+    reference.initialize(1e-4);
+    reference.step_simulation(days);
+
+    cout << "stages = " << stages << " (" << reference.nbins << " variables), " << years << " years" << endl;
+    const char* names[] = {"rkf45", "rosenbrock_dense", "rosenbrock_fd", "rosenbrock_exact"};
+    for (int mode = 0; mode < 4; mode++) {
+        Staged_SEIR sim(stages, BETA, SIGMA, GAMMA, MU, IOTA);
+        sim.set_tolerances(1e-8, 1e-6);
+        if (mode > 0) sim.set_solver(DiffEq_Sim::ROSENBROCK);
+        if (mode >= 2) sim.define_pattern(mode == 3);
+        sim.initialize(1e-4);
+        clock_t start = clock();
+        int status = sim.step_simulation(days);
+        double seconds = seconds_since(start);
+
+        double max_err = 0;
+        for (size_t i = 0; i < sim.nbins; i++) max_err = max(max_err, fabs(sim.y[i] - reference.y[i]));
+        cout << "  " << names[mode] << "\t" << seconds << " s\t" << sim.rhs_calls << " derivative calls\t"
+             << "max error " << max_err << (status ? "\t(failed)" : "") << endl;
+    }
+}
+
+int main() {
+    bench(10, 50);
+    bench(50, 50);
+    return 0;
+}
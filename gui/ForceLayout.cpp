@@ -1,7 +1,13 @@
 #include "ForceLayout.h"
+#include <QHash>
+#include <atomic>
+#include <thread>
 
 using namespace std;
 
+const int CHARGE_BLOCK = 256;               // particles per unit of work in _chargeforces()
+const int MIN_PARTICLES_PER_THREAD = 2048;  // fewer, and threads cost more than they save
+
 ForceLayout::ForceLayout(): dragConstant(0.1),     // 0.1
                            chargeConstant(-10),    // -40
                            chargeMinDistance(2),   //   2
@@ -15,170 +21,228 @@ ForceLayout::ForceLayout(): dragConstant(0.1),     // 0.1
                            xmin(-150),
                            xmax(150),
                            ymin(-150),
-                           ymax(150){}
+                           ymax(150),
+                           topologyValid(false) {
+    set_num_threads(thread::hardware_concurrency());
+}
 
 
 void ForceLayout::doLayout(QVector<Particle *> &particles, int iterations=1) {
-    // cerr << "doLayout()\n";
-    // kl used for spring forces
-    std::vector<double> kl;
-    for (auto p: particles) {
-        for (auto link: p->edgesOut()) {
-            Particle* n = link->dest();
-            //kl.push_back( 1.0/pow(std::max(p->totalDegree(), n->totalDegree()), 0.25) );
-            const float d1 = p->totalDegree();
-            const float d2 = n->totalDegree();
-            kl.push_back( 1.0/pow(sqrt((d1*d1 + d2*d2)/2.0), 0.5) );
-        }
-    }
+    if (particles.empty()) return;
+    _load(particles);
+    for (int t = 0; t<iterations; ++t) _step();
+    _store(particles);
+}
 
-    for (int t = 0; t<iterations; ++t) {
-        /*
-        * Assumptions:
-        * - The mass (m) of every particles is 1.
-        * - The time step (dt) is 1.
-        */
 
-        /* Apply constraints, then accumulate new forces. */
-        Quadtree* q = new Quadtree(particles);
+void ForceLayout::_load(QVector<Particle *> &particles) {
+    const int n = particles.size();
+    if (not topologyValid or (int) x.size() != n) {
+        x.resize(n); y.resize(n);
+        px.resize(n); py.resize(n);
+        vx.resize(n); vy.resize(n);
+        fx.resize(n); fy.resize(n);
 
-        for (auto p: particles) {
-            // make particles stay in scene
-            const double cx = p->x();
-            const double cy = p->y();
-            double nx = cx;
-            double ny = cy;
-            if (cx < xmin) p->px = nx = xmin;
-            else if (cx > xmax) p->px = nx = xmax;
-            if (cy < ymin) p->py = ny = ymin;
-            else if (cy > ymax) p->py = ny = ymax;
-            if (nx != cx or ny != cy) p->setPos(nx,ny);
-
-            // clear old forces
-            p->fx = 0;
-            p->fy = 0;
-        }
+        QHash<Particle*, int> index;
+        for (int i = 0; i < n; ++i) index[particles[i]] = i;
 
-        // drag
-        if (dragConstant) {
-            for (auto p: particles) {
-                p->fx -= dragConstant * p->vx;
-                p->fy -= dragConstant * p->vy;
+        // kl used for spring forces
+        linkSource.clear();
+        linkDest.clear();
+        kl.clear();
+        for (auto p: particles) {
+            for (auto link: p->edgesOut()) {
+                Particle* m = link->dest();
+                if (not index.contains(m)) continue;
+                //kl.push_back( 1.0/pow(std::max(p->totalDegree(), m->totalDegree()), 0.25) );
+                const float d1 = p->totalDegree();
+                const float d2 = m->totalDegree();
+                linkSource.push_back(index[p]);
+                linkDest.push_back(index[m]);
+                kl.push_back( 1.0/pow(sqrt((d1*d1 + d2*d2)/2.0), 0.5) );
             }
         }
+        topologyValid = true;
+    }
 
-        // charge
-        _accumulateCharge(q->root);
-        for (auto p: particles) {
-            _chargeforces(q->root, p, q->xMin, q->yMin, q->xMax, q->yMax);
-        }
+    // positions are re-read every time, since nodes may have been dragged
+    for (int i = 0; i < n; ++i) {
+        Particle* p = particles[i];
+        x[i]  = p->x();
+        y[i]  = p->y();
+        px[i] = p->px;
+        py[i] = p->py;
+        vx[i] = p->vx;
+        vy[i] = p->vy;
+    }
+}
 
-        // spring
-        for (auto p: particles) {
-            QVector<Link*> links_out = p->edgesOut();
-            for (int i = 0; i < links_out.size(); ++i) {
-                Particle* a = links_out[i]->source();
-                Particle* b = links_out[i]->dest();
-                const double dx = a->x() - b->x();         // x displacement
-                const double dy = a->y() - b->y();         // y displacement
-                const double dn = sqrt(dx * dx + dy * dy); // spring length
-                const double dd = dn ? (1.0 / dn) : 1.0;   // 1 / spring length
-                const double ks = springConstant * kl[i];  // normalized tension
-                const double kd = springDamping * kl[i];   // normalized damping
-                const double kk = (ks * (dn - springLength) + kd * (dx * (a->vx - b->vx) + dy * (a->vy - b->vy)) * dd) * dd;
-                double fx = -kk * (dn ? dx : (0.001 * (0.5 - rand()/RAND_MAX)));
-                double fy = -kk * (dn ? dy : (0.001 * (0.5 - rand()/RAND_MAX)));
-                const double fn = sqrt(fx*fx + fy*fy);
-                const double governor = fn > springMaxForce ? fn/springMaxForce: 1.0;
-                fx /= governor;
-                fy /= governor;
-                a->fx += fx;
-                a->fy += fy;
-                b->fx -= fx;
-                b->fy -= fy;
+
+void ForceLayout::_store(QVector<Particle *> &particles) {
+    for (int i = 0; i < particles.size(); ++i) {
+        Particle* p = particles[i];
+        p->px = px[i];
+        p->py = py[i];
+        p->vx = vx[i];
+        p->vy = vy[i];
+        p->fx = fx[i];
+        p->fy = fy[i];
+        if (x[i] != p->x() or y[i] != p->y()) p->setPos(x[i], y[i]);
+    }
+}
+
+
+void ForceLayout::_step() {
+    /*
+    * Assumptions:
+    * - The mass (m) of every particles is 1.
+    * - The time step (dt) is 1.
+    */
+    const int n = x.size();
+
+    /* Apply constraints, then accumulate new forces. */
+    for (int i = 0; i < n; ++i) {
+        // make particles stay in scene
+        if (x[i] < xmin) px[i] = x[i] = xmin;
+        else if (x[i] > xmax) px[i] = x[i] = xmax;
+        if (y[i] < ymin) py[i] = y[i] = ymin;
+        else if (y[i] > ymax) py[i] = y[i] = ymax;
+
+        // clear old forces, and apply drag
+        fx[i] = -dragConstant * vx[i];
+        fy[i] = -dragConstant * vy[i];
+    }
+
+    // charge
+    quadtree.build(x, y);
+    _accumulateCharge();
+    const int threads = min(numThreads, max(1, n / MIN_PARTICLES_PER_THREAD));
+    if (threads == 1) {
+        _chargeforces(0, n);
+    } else {
+        // threads take blocks of particles until none are left; each particle's
+        // force is written by one thread only
+        atomic<int> next(0);
+        auto worker = [&]() {
+            for (int first = next.fetch_add(CHARGE_BLOCK); first < n; first = next.fetch_add(CHARGE_BLOCK)) {
+                _chargeforces(first, min(n, first + CHARGE_BLOCK));
             }
-        }
+        };
+        vector<thread> pool;
+        for (int t = 1; t < threads; ++t) pool.push_back(thread(worker));
+        worker();
+        for (auto& th: pool) th.join();
+    }
 
-        /* Position Verlet integration. */
-        for ( auto p: particles) {
-            const double px = p->px;
-            const double py = p->py;
-            const double cx = p->x();
-            const double cy = p->y();
-            p->px = cx;
-            p->py = cy;
-            p->vx = cx - px + p->fx;
-            p->vy = cy - py + p->fy;
-            const double s = _speed(p);
-            const double governor = s > speedMax ? s/speedMax : 1.0;
-            const double x = cx + p->vx/governor;
-            const double y = cy + p->vy/governor;
-            p->setPos(x,y);
-        }
+    // spring
+    for (unsigned int i = 0; i < linkSource.size(); ++i) {
+        const int a = linkSource[i];
+        const int b = linkDest[i];
+        const double dx = x[a] - x[b];         // x displacement
+        const double dy = y[a] - y[b];         // y displacement
+        const double dn = sqrt(dx * dx + dy * dy); // spring length
+        const double dd = dn ? (1.0 / dn) : 1.0;   // 1 / spring length
+        const double ks = springConstant * kl[i];  // normalized tension
+        const double kd = springDamping * kl[i];   // normalized damping
+        const double kk = (ks * (dn - springLength) + kd * (dx * (vx[a] - vx[b]) + dy * (vy[a] - vy[b])) * dd) * dd;
+        double sfx = -kk * (dn ? dx : (0.001 * (0.5 - rand()/RAND_MAX)));
+        double sfy = -kk * (dn ? dy : (0.001 * (0.5 - rand()/RAND_MAX)));
+        const double fn = sqrt(sfx*sfx + sfy*sfy);
+        const double governor = fn > springMaxForce ? fn/springMaxForce: 1.0;
+        sfx /= governor;
+        sfy /= governor;
+        fx[a] += sfx;
+        fy[a] += sfy;
+        fx[b] -= sfx;
+        fy[b] -= sfy;
+    }
+
+    /* Position Verlet integration. */
+    for (int i = 0; i < n; ++i) {
+        const double cx = x[i];
+        const double cy = y[i];
+        vx[i] = cx - px[i] + fx[i];
+        vy[i] = cy - py[i] + fy[i];
+        px[i] = cx;
+        py[i] = cy;
+        const double s = sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+        const double governor = s > speedMax ? s/speedMax : 1.0;
+        x[i] = cx + vx[i]/governor;
+        y[i] = cy + vy[i]/governor;
+    }
+}
 
-        delete q;   //delete quad tree
+
+void ForceLayout::_chargeforces(int first, int last) {
+    for (int p = first; p < last; ++p) {
+        double cfx = 0;
+        double cfy = 0;
+        _chargeforce(0, p, quadtree.xMin, quadtree.yMin, quadtree.xMax, quadtree.yMax, cfx, cfy);
+        fx[p] += cfx;
+        fy[p] += cfy;
     }
 }
 
-double ForceLayout::_speed(Particle *n) { return sqrt(n->vx * n->vx + n->vy * n->vy); }
 
-void ForceLayout::_chargeforces(QuadtreeNode* n, Particle *p, double x1, double y1, double x2, double y2) {
-    double dx = n->cx - p->x();
-    double dy = n->cy - p->y();
+void ForceLayout::_chargeforce(int i, int p, double x1, double y1, double x2, double y2, double& cfx, double& cfy) const {
+    const QuadtreeNode& n = quadtree.nodes[i];
+    double dx = n.cx - x[p];
+    double dy = n.cy - y[p];
     double dn = 1.0 / sqrt(dx * dx + dy * dy);
     const double min1 = 1.0/chargeMinDistance;
     const double max1 = 1.0/chargeMaxDistance;
 
     /* Barnes-Hut criterion-> */
-    if ((n->leaf && (n->p != p)) || ((x2 - x1) * dn < chargeTheta)) {
+    if ((n.leaf && (n.p != p)) || ((x2 - x1) * dn < chargeTheta)) {
         if (dn < max1) return;
         if (dn > min1) dn = min1;
-        double kc = n->cn * dn * dn * dn;
-        double fx = dx * kc;
-        double fy = dy * kc;
-        p->fx += fx;
-        p->fy += fy;
-    } else if (!n->leaf) {
+        double kc = n.cn * dn * dn * dn;
+        cfx += dx * kc;
+        cfy += dy * kc;
+    } else if (!n.leaf) {
         double sx = (x1 + x2) * .5;
         double sy = (y1 + y2) * .5;
-        if (n->c1) _chargeforces(n->c1, p, x1, y1, sx, sy);
-        if (n->c2) _chargeforces(n->c2, p, sx, y1, x2, sy);
-        if (n->c3) _chargeforces(n->c3, p, x1, sy, sx, y2);
-        if (n->c4) _chargeforces(n->c4, p, sx, sy, x2, y2);
+        if (n.c[0] >= 0) _chargeforce(n.c[0], p, x1, y1, sx, sy, cfx, cfy);
+        if (n.c[1] >= 0) _chargeforce(n.c[1], p, sx, y1, x2, sy, cfx, cfy);
+        if (n.c[2] >= 0) _chargeforce(n.c[2], p, x1, sy, sx, y2, cfx, cfy);
+        if (n.c[3] >= 0) _chargeforce(n.c[3], p, sx, sy, x2, y2, cfx, cfy);
         if (dn < max1) return;
         if (dn > min1) dn = min1;
-        if (n->p && (n->p != p)) {
+        if (n.p >= 0 && (n.p != p)) {
             double kc = chargeConstant * dn * dn * dn;
-            double fx = dx * kc;
-            double fy = dy * kc;
-            p->fx += fx;
-            p->fy += fy;
+            cfx += dx * kc;
+            cfy += dy * kc;
         }
     }
 }
-void ForceLayout::_accumulateCharge(QuadtreeNode* n) {
-    double cx = 0;
-    double cy = 0;
-    n->cn = 0;
-
-    if (!n->leaf) {
-        if (n->c1) _accumulateChild(n->c1, n, cx, cy);
-        if (n->c2) _accumulateChild(n->c2, n, cx, cy);
-        if (n->c3) _accumulateChild(n->c3, n, cx, cy);
-        if (n->c4) _accumulateChild(n->c4, n, cx, cy);
-    }
-    if (n->p) {
-        n->cn += chargeConstant;
-        cx += chargeConstant * n->p->x();
-        cy += chargeConstant * n->p->y();
-    }
-    n->cx = cx / n->cn;
-    n->cy = cy / n->cn;
-}
 
-void ForceLayout::_accumulateChild(QuadtreeNode* c, QuadtreeNode* n, double& cx, double& cy) {
-    _accumulateCharge(c);
-    n->cn += c->cn;
-    cx += c->cn * c->cx;
-    cy += c->cn * c->cy;
+
+// Total charge and center of charge of every quadtree node.  Children come
+// after their parents in the node array, so a backwards pass sees every child
+// before its parent.
+void ForceLayout::_accumulateCharge() {
+    vector<QuadtreeNode>& nodes = quadtree.nodes;
+    for (int i = nodes.size() - 1; i >= 0; --i) {
+        QuadtreeNode& n = nodes[i];
+        double cx = 0;
+        double cy = 0;
+        n.cn = 0;
+
+        if (!n.leaf) {
+            for (int k = 0; k < 4; ++k) {
+                if (n.c[k] < 0) continue;
+                const QuadtreeNode& c = nodes[n.c[k]];
+                n.cn += c.cn;
+                cx += c.cn * c.cx;
+                cy += c.cn * c.cy;
+            }
+        }
+        if (n.p >= 0) {
+            n.cn += chargeConstant;
+            cx += chargeConstant * x[n.p];
+            cy += chargeConstant * y[n.p];
+        }
+        n.cx = cx / n.cn;
+        n.cy = cy / n.cn;
+    }
 }
@@ -9,12 +9,23 @@
 
 class GNode;
 class GEdge;
-class QuadtreeNode;
 //class Particle;
 //class Link;
 typedef GNode Particle;
 typedef GEdge Link;
 
+/*
+ * Force-directed layout: drag, Barnes-Hut charge repulsion, and springs along
+ * edges, integrated with position Verlet.
+ *
+ * doLayout() copies positions and velocities out of the scene items into flat
+ * arrays, runs all of its iterations on those, and writes the results back to
+ * the items once at the end.  The charge forces, which are the expensive part,
+ * are computed for blocks of particles on several threads.  Link endpoints and
+ * weights are kept between calls; call invalidate() when nodes or edges are
+ * added or removed.
+ */
+
 class ForceLayout {
     private:
         double dragConstant;
@@ -31,17 +42,36 @@ class ForceLayout {
         double xmax;
         double ymin;
         double ymax;
+        int numThreads;
+
+        // particle state, by index in the particle list
+        std::vector<double> x, y;       // position
+        std::vector<double> px, py;     // previous position
+        std::vector<double> vx, vy;     // velocity
+        std::vector<double> fx, fy;     // force
+
+        // links, and the spring weight of each
+        bool topologyValid;
+        std::vector<int> linkSource;
+        std::vector<int> linkDest;
+        std::vector<double> kl;
+
+        Quadtree quadtree;
 
-        double _speed(Particle* n);
-        void _chargeforces(QuadtreeNode* n, Particle* p, double x1, double y1, double x2, double y2);
-        void _accumulateCharge(QuadtreeNode* n);
-        void _accumulateChild(QuadtreeNode* c, QuadtreeNode* n, double& cx, double& cy);
+        void _load(QVector<Particle*> &particles);
+        void _store(QVector<Particle*> &particles);
+        void _step();
+        void _accumulateCharge();
+        void _chargeforces(int first, int last);
+        void _chargeforce(int n, int p, double x1, double y1, double x2, double y2, double& fx, double& fy) const;
 
     public:
         ForceLayout();
 
         void doLayout(QVector<Particle*> &particles, int iterations);
         void set_dimensions(double x, double X, double y, double Y) {xmin=x; xmax=X; ymin=y; ymax=Y;}
+        void set_num_threads(int n) { numThreads = n > 0 ? n : 1; }
+        void invalidate() { topologyValid = false; }
 };
 
 #endif
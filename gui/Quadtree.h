@@ -4,9 +4,6 @@
 #include <math.h>
 #include <vector>
 #include <iostream>
-#include "node.h"
-#include "edge.h"
-#include <QVector>
 
 /**
  * Constructs a new quadtree for the specified array of particles.
@@ -21,82 +18,24 @@
  * as the Barnes-Hut approximation for computing n-body forces, or collision
  * detection.
  *
+ * <p>Nodes are kept in one array, which is emptied but not freed between
+ * builds, so rebuilding the tree every layout iteration does not allocate.
+ * Children always come after their parent in the array, so walking it
+ * backwards visits every node after its children.
+ *
  * @see pv.Force.charge
  * @see pv.Constraint.collision
- * @param {pv.Particle} particles the linked list of particles.
  */
 
-class GNode;
-typedef GNode Particle;
-
-class GEdge;
-typedef GEdge Link;
-//class Particle;
-
-
-/*class Link {
-  private:
-    Particle* _source;
-    Particle* _dest;
-  public:
-    Particle* source() { return _source; }
-    Particle* dest() { return _dest; }
-    Link (Particle* s, Particle* d):_source(s), _dest(d) {}
-};
-
-class Particle {
-  private:
-    double _x;
-    double _y;
-    QVector<Link*> _edgesIn;
-    QVector<Link*> _edgesOut;
-
-  public:
-    double vx;
-    double vy;
-    double fx;
-    double fy;
-
-    double px;  //previous x and y positions
-    double py;
-    double x() const { return _x; }
-    double y() const { return _y; }
-    void setPos(double x, double y) { _x = x; _y = y; }
-    QVector<Link*>* edgesIn() { return &_edgesIn; }
-    QVector<Link*>* edgesOut() { return &_edgesOut; }
-
-    Particle (double xi, double yi ) : _x(xi), _y(yi), vx(0), vy(0), fx(0), fy(0), px(xi), py(yi) {}
-    ~Particle() { for (auto e: _edgesIn) delete e; for (auto e: _edgesOut) delete e; }
-    int totalDegree() { return _edgesIn.size() + _edgesOut.size(); }
-};*/
-
 class QuadtreeNode {
   public:
     bool leaf = true;
-    QuadtreeNode* c1 = nullptr;
-    QuadtreeNode* c2 = nullptr;
-    QuadtreeNode* c3 = nullptr;
-    QuadtreeNode* c4 = nullptr;
-    Particle*     p  = nullptr;
+    int c[4] = {-1, -1, -1, -1};    // children, by quadrant; -1 if none
+    int p = -1;                     // particle, or -1
 
     double cx = 0;
     double cy = 0;
     double cn = 0;
-
-/*    void print() {
-        if(p) std::cerr << "P[xy] = " << p->x() << "," << p->y() << std::endl;
-        if(c1) c1->print();
-        if(c2) c2->print();
-        if(c3) c3->print();
-        if(c4) c4->print();
-    }*/
-
-    ~QuadtreeNode() { 
-        if(c1) delete(c1);
-        if(c2) delete(c2);
-        if(c3) delete(c3);
-        if(c4) delete(c4);
-    }
 };
 
 class Quadtree {
@@ -105,13 +44,19 @@ class Quadtree {
     double xMax;
     double yMin;
     double yMax;
-    QuadtreeNode* root;
+    std::vector<QuadtreeNode> nodes;   // nodes[0] is the root
+
+    Quadtree() : xMin(0), xMax(0), yMin(0), yMax(0) {}
 
-    Quadtree(QVector<Particle*>& particles);
-    ~Quadtree() { if(root) delete(root); }
+    // particle i is at (x[i], y[i])
+    void build(const std::vector<double>& x, const std::vector<double>& y);
+
+  private:
+    const double* px;
+    const double* py;
 
-    void insertChild( QuadtreeNode* n, Particle* p, double x1, double y1, double x2, double y2 );
-    void insert( QuadtreeNode* n, Particle* p, double x1, double y1, double x2, double y2 );
+    int child( int n, int p, double& x1, double& y1, double& x2, double& y2 );
+    void insert( int p );
 };
 
 #endif
@@ -54,6 +54,8 @@ void AnalysisDialog::createNetworkAnalysis() {
     transitivityEdit     = new QLineEdit(this);
     diameterEdit         = new QLineEdit(this);
     meanDistanceEdit     = new QLineEdit(this);
+    communityCountEdit   = new QLineEdit(this);
+    modularityEdit       = new QLineEdit(this);
 
     makeReadonly(nodeCountEdit);
     makeReadonly(edgeCountEdit);
@@ -63,18 +65,24 @@ void AnalysisDialog::createNetworkAnalysis() {
     makeReadonly(transitivityEdit);
     makeReadonly(diameterEdit);
     makeReadonly(meanDistanceEdit);
+    makeReadonly(communityCountEdit);
+    makeReadonly(modularityEdit);
 
     componentButton1   = new QPushButton("Calculate", this);
     componentButton2   = new QPushButton("Calculate", this);
     transitivityButton = new QPushButton("Calculate", this);
     diameterButton     = new QPushButton("Calculate", this);
     meanDistanceButton = new QPushButton("Calculate", this);
+    communityButton1   = new QPushButton("Calculate", this);
+    communityButton2   = new QPushButton("Calculate", this);
 
     connect(componentButton1,   SIGNAL(clicked()), this, SLOT(generate_comp_thread()));
     connect(componentButton2,   SIGNAL(clicked()), this, SLOT(generate_comp_thread()));
     connect(transitivityButton, SIGNAL(clicked()), this, SLOT(generate_trans_thread()));
     connect(diameterButton,     SIGNAL(clicked()), this, SLOT(generate_dist_thread()));
     connect(meanDistanceButton, SIGNAL(clicked()), this, SLOT(generate_dist_thread()));
+    connect(communityButton1,   SIGNAL(clicked()), this, SLOT(generate_comm_thread()));
+    connect(communityButton2,   SIGNAL(clicked()), this, SLOT(generate_comm_thread()));
 
     _addNetAnalysisRow(netTopLayout, "Node count:",         nodeCountEdit);
     _addNetAnalysisRow(netTopLayout, "Edge count:",         edgeCountEdit);
@@ -84,6 +92,8 @@ void AnalysisDialog::createNetworkAnalysis() {
     _addNetAnalysisRow(netTopLayout, "Transitivity:",       transitivityEdit, transitivityButton);
     _addNetAnalysisRow(netTopLayout, "Diameter:",           diameterEdit, diameterButton);
     _addNetAnalysisRow(netTopLayout, "Mean shortest path:", meanDistanceEdit, meanDistanceButton);
+    _addNetAnalysisRow(netTopLayout, "Community count:",    communityCountEdit, communityButton1);
+    _addNetAnalysisRow(netTopLayout, "Modularity:",         modularityEdit, communityButton2);
 
     QGroupBox* netAnalysisTop = new QGroupBox();
     netAnalysisTop->setLayout(netTopLayout);
@@ -248,6 +258,8 @@ void AnalysisDialog::analyzeNetwork() {
     transitivityEdit     ->clear();
     diameterEdit         ->clear();
     meanDistanceEdit     ->clear();
+    communityCountEdit   ->clear();
+    modularityEdit       ->clear();
 
     degDistPlot->clearData();
     degDistPlot->addData(network->get_deg_series());
@@ -359,12 +371,16 @@ void AnalysisDialog::updateGUI() {
     if (transitivityData.isUpdated)     transitivityEdit    ->setText(QString::number( transitivityData.value ));
     if (diameterData.isUpdated)         diameterEdit        ->setText(QString::number( diameterData.value ));
     if (meanDistanceData.isUpdated)     meanDistanceEdit    ->setText(QString::number( meanDistanceData.value ));
+    if (communityCountData.isUpdated)   communityCountEdit  ->setText(QString::number( communityCountData.value ));
+    if (modularityData.isUpdated)       modularityEdit      ->setText(QString::number( modularityData.value ));
 
     componentCountData.isUpdated   = false;
     maxComponentSizeData.isUpdated = false;
     transitivityData.isUpdated     = false;
     diameterData.isUpdated         = false;
     meanDistanceData.isUpdated     = false;
+    communityCountData.isUpdated   = false;
+    modularityData.isUpdated       = false;
 }
 
 
@@ -387,9 +403,27 @@ void AnalysisDialog::calculateComponentStats() {
 
 void AnalysisDialog::calculateTransitivity() {
     if (!network) return;
-    vector<Node*> empty;
-    const double transitivity = network->transitivity(empty);
-    transitivityData = {true, transitivity};
+    // Counts connected triples and triangles in blocks of nodes, across all of
+    // the background thread's workers
+    WorkerPool* pool = mw->backgroundThread->workerPool();
+    const int n = network->size();
+    const int block = 256;
+    atomic<long long> triangles(0);
+    atomic<long long> tripples(0);
+
+    pool->setTotal(n);
+    pool->run((n + block - 1) / block, [&](int chunk, int) {
+        long long tri = 0;
+        long long trip = 0;
+        const int last = min(n, (chunk + 1) * block);
+        network->transitivity(chunk * block, last, tri, trip);
+        triangles += tri;
+        tripples += trip;
+        pool->addDone(last - chunk * block);
+    }, [&]() { mw->backgroundThread->reportProgress(); });
+
+    if (pool->cancelled()) return;
+    transitivityData = {true, (double) triangles / (double) tripples};
 }
 
 
@@ -398,38 +432,66 @@ void AnalysisDialog::calculateDistances() {
     mw->progressDialog->setLabelText("Finding biggest component ...");
     calculateComponentStats();
     vector< vector<Node*> >& netComponents = mw->netComponents;
-    vector<Node*>& giant_comp = netComponents[0];
 
     // locate the biggest component in the network
+    int giant = 0;
     for (unsigned int i = 1; i < netComponents.size(); i++) {
-        if (netComponents[i].size() > giant_comp.size()) {
-            giant_comp = netComponents[i];
-        }
+        if (netComponents[i].size() > netComponents[giant].size()) giant = i;
     }
-    
+    vector<Node*>& giant_comp = netComponents[giant];
+    const int n = giant_comp.size();
+    if (n < 2) {
+        diameterData     = {true, 0.0};
+        meanDistanceData = {true, 0.0};
+        return;
+    }
+
     mw->progressDialog->setLabelText("Finding shortest paths in component ...");
-    // calculate the shortest path lengths within it
-    //for(unsigned int t = 0; t< (*giant_comp).size(); t++) cerr << (*giant_comp)[t]->get_id() << endl;
-    vector< vector<double> > pathLengths;
-    network->calculate_distances(giant_comp, pathLengths);
-    double diam = 0.0;
-    double mean = 0.0;
-    for (unsigned int i = 0; i<pathLengths.size(); i++) {
+    // shortest path lengths from node i to the nodes after it in the
+    // component, one source node at a time across the workers; only the
+    // longest and the mean of each row are kept
+    WorkerPool* pool = mw->backgroundThread->workerPool();
+    vector<double> row_max(n - 1, 0.0);
+    vector<double> row_mean(n - 1, 0.0);
+    pool->setTotal(n - 1);
+    pool->run(n - 1, [&](int i, int) {
+        vector<Node*> node_set(giant_comp.begin() + i + 1, giant_comp.end());
+        vector<double> pathLengths = giant_comp[i]->min_paths(node_set);
+        double diam = 0.0;
         double node_mean = 0.0;
-        for (unsigned int j = 0; j<pathLengths[i].size(); j++) {
-            //if (i==j) continue;
-            diam = pathLengths[i][j] > diam ? pathLengths[i][j] : diam;
-            node_mean += pathLengths[i][j];
+        for (unsigned int j = 0; j<pathLengths.size(); j++) {
+            diam = pathLengths[j] > diam ? pathLengths[j] : diam;
+            node_mean += pathLengths[j];
         }
-        node_mean /= pathLengths[i].size();
-        mean += node_mean;
+        row_max[i]  = diam;
+        row_mean[i] = node_mean / pathLengths.size();
+        pool->addDone();
+    }, [&]() { mw->backgroundThread->reportProgress(); });
+
+    if (pool->cancelled()) return;
+    double diam = 0.0;
+    double mean = 0.0;
+    for (int i = 0; i < n - 1; i++) {
+        diam = row_max[i] > diam ? row_max[i] : diam;
+        mean += row_mean[i];
     }
-    mean /= pathLengths.size();
+    mean /= n - 1;
 
     diameterData     = {true, diam};
     meanDistanceData = {true, mean};
 }
 
+void AnalysisDialog::calculateCommunities() {
+    if (!network) return;
+    // edge costs, if there are any, are used as weights
+    Louvain louvain(network, network->is_weighted());
+    louvain.run();
+    mw->netCommunities = louvain.get_communities();
+
+    communityCountData = {true, (double) louvain.num_communities()};
+    modularityData     = {true, louvain.get_modularity()};
+}
+
 int AnalysisDialog::find_epi_threshold() {
     // quick and dirty way to guess the threshold between outbreaks and epidemics
     vector< vector<int> > plotData = resultsHistPlot->getData();
@@ -493,3 +555,10 @@ void AnalysisDialog::generate_dist_thread() {
     mw->backgroundThread->start();
 }
 
+
+void AnalysisDialog::generate_comm_thread() {
+    mw->setCursor(Qt::WaitCursor);
+    mw->backgroundThread->setThreadType(BackgroundThread::COMMUNITIES);
+    mw->progressDialog->setLabelText("Finding communities");
+    mw->backgroundThread->start();
+}
@@ -8,6 +8,7 @@
 #include "mainWindow.h"
 #include "backgroundthread.h"
 #include "../src/Network.h"
+#include "../src/Louvain.h"
 
 class MainWindow;
 class BackgroundThread;
@@ -37,6 +38,8 @@ class AnalysisDialog: public QDialog {
         void calculateTransitivity();
         void generate_dist_thread();
         void calculateDistances();
+        void generate_comm_thread();
+        void calculateCommunities();
         void updateGUI();
 
         // Results analysis slots
@@ -66,18 +69,24 @@ class AnalysisDialog: public QDialog {
         QLineEdit* transitivityEdit;
         QLineEdit* diameterEdit;
         QLineEdit* meanDistanceEdit;
+        QLineEdit* communityCountEdit;
+        QLineEdit* modularityEdit;
 
         BT_Data componentCountData;
         BT_Data maxComponentSizeData;
         BT_Data transitivityData;
         BT_Data diameterData;
         BT_Data meanDistanceData;
+        BT_Data communityCountData;
+        BT_Data modularityData;
 
         QPushButton* componentButton1;
         QPushButton* componentButton2;
         QPushButton* transitivityButton;
         QPushButton* diameterButton;
         QPushButton* meanDistanceButton;
+        QPushButton* communityButton1;
+        QPushButton* communityButton2;
 
         PlotView* degDistPlot;
 
@@ -3,6 +3,9 @@
 BackgroundThread::BackgroundThread(MainWindow* w) { 
       mw=w; 
       _stopped=true;
+      pool = new WorkerPool();
+      _lastPhase = 0;
+      _lastDone = 0;
       setTerminationEnabled(true);
 
        
@@ -18,25 +21,55 @@ BackgroundThread::BackgroundThread(MainWindow* w) {
      connect(this, SIGNAL(showProgressDialog()), mw->progressDialog, SLOT(show())); 
      connect(this, SIGNAL(hideProgressDialog()), mw->progressDialog, SLOT(hide())); 
      connect(this, SIGNAL(appendOutputLine(QString)), mw, SLOT(appendOutputLine(QString))); 
+
+     // the thread object lives in the GUI thread, so this polls from there
+     _progressTimerID = startTimer(100);
+}
+
+BackgroundThread::~BackgroundThread() {
+    delete pool;
 }
 
 void BackgroundThread::stop() {
     _stopped=true;
+    pool->cancel();
     emit updateDialogText("Stopping . . . please wait");
-    if (type != SIMULATE) {
-        mw->network->stop_processing();
-    }
-    while (this->isRunning()) msleep(50);
-    mw->network->reset_processing_flag();
+    progress.cancel();
+    wait(); // workers check for cancellation between steps, so this is short
+    progress.reset();
     emit hideProgressDialog();
     //cerr << "Dialog hidden!\n";
     emit updateDialogText("");
 }
 
 
+// Passes on what the network reports to its Progress.  Only phases that have
+// started since the last tick, or that have moved on, are reported, so this
+// stays quiet while the work is being done elsewhere (e.g. in the worker pool).
+void BackgroundThread::timerEvent(QTimerEvent* event) {
+    if (event->timerId() != _progressTimerID or _stopped) return;
+
+    const int phase = progress.phase();
+    const long done = progress.done();
+    if (phase == 0) { _lastPhase = 0; return; }
+    if (phase == _lastPhase and done == _lastDone) return;
+    _lastPhase = phase;
+    _lastDone = done;
+
+    QString text = QString(progress.phase_name()) + " ...";
+    const double eta = progress.eta();
+    if (eta >= 1) text += QString(" (about %1 s left)").arg((int) (eta + 0.5));
+    emit updateDialogText(text);
+    emit setProgressValue((int) (100 * progress.fraction()));
+}
+
+
 
 void BackgroundThread::run(void) { 
     _stopped=false;
+    pool->reset();
+    progress.reset();
+    if (mw->network) mw->network->set_progress(&progress);
 
     if (type == GENERATE_NET ) {
         emit setProgressValue(0);
@@ -58,6 +91,10 @@ void BackgroundThread::run(void) {
         emit showProgressDialog();
         mw->netAnalysisDialog->calculateDistances();
         emit setProgressValue(100);
+    } else if (type == COMMUNITIES ) {
+        emit setProgressValue(0);
+        mw->netAnalysisDialog->calculateCommunities();
+        emit setProgressValue(100);
     } else if (type == SIMULATE ) {
         emit setProgressValue(0);
         runSimulation();
@@ -78,14 +115,40 @@ void BackgroundThread::runSimulation() {
     double predictedSize = (mw->maPredictionLine->text()).toDouble();
     int currentSize = patient_zero_ct;
 
-    vector<int> epi_sizes (j_max);
+    vector<int> epi_sizes;
     
     if (mw->retainDataCheckBox->isChecked() == false) {
         mw->epiCurvePlot->clearData();
         mw->histPlot->clearData();
     }
+
+    // With more than one worker, all replicates but the last are run in
+    // parallel by an Ensemble, whose threads share one read-only copy of the
+    // topology and each keep their own node states and random number
+    // generator.  The last one is always run on the network itself, so that
+    // the state plot and the network animation can show it.  Models the
+    // Ensemble doesn't have are run serially.
+    int parallel_reps = pool->size() > 1 ? j_max - 1 : 0;
+    if (parallel_reps > 0) {
+        emit statusChanged(busySimMsg);
+        vector< vector<int> > epi_curves;
+        vector<int> sizes;          // -1: interrupted
+        if (runEnsemble(parallel_reps, patient_zero_ct, sizes, epi_curves)) {
+            // report replicates in order
+            for (int r = 0; r < parallel_reps; r++) {
+                if (sizes[r] < 0) continue;
+                QString rep_str = QString::number(++(mw->rep_ct), 10);
+                emit appendOutputLine("Rep: " + rep_str + ", Total infected: " + QString::number(sizes[r],10));
+                mw->epiCurvePlot->addData(epi_curves[r]);
+                epi_sizes.push_back(sizes[r]);
+            }
+            if (_stopped) emit statusChanged("Simulation interrupted");
+        } else {
+            parallel_reps = 0;
+        }
+    }
     
-    for ( j = 0; j < j_max; j++) {
+    for ( j = parallel_reps; j < j_max; j++) {
         if (_stopped) break;
         QString rep_str = QString::number(++(mw->rep_ct), 10);
         emit statusChanged(busySimMsg);
@@ -119,11 +182,10 @@ void BackgroundThread::runSimulation() {
 
         if (_stopped) {
             emit statusChanged("Simulation interrupted");
-            epi_sizes.resize(j);
         } else {
             emit statusChanged("Simulation complete");
             mw->epiCurvePlot->addData(epi_curve);
-            epi_sizes[j] = epi_size;
+            epi_sizes.push_back(epi_size);
         }
 
         mw->simulator->reset();
@@ -137,3 +199,23 @@ void BackgroundThread::runSimulation() {
 }
 
 
+// Runs reps replicates of the main simulator's model, with its parameters, on
+// an Ensemble with one thread per worker.  Returns false, without running
+// anything, if the Ensemble doesn't have that model.
+bool BackgroundThread::runEnsemble(int reps, int patient_zero_ct, vector<int>& sizes, vector< vector<int> >& epi_curves) {
+    ChainBinomial_Sim* cb = dynamic_cast<ChainBinomial_Sim*>(mw->simulator);
+    Percolation_Sim* perc = dynamic_cast<Percolation_Sim*>(mw->simulator);
+    if (cb == NULL and perc == NULL) return false;
+
+    Ensemble ens(mw->network, pool->size());
+    ens.seed((*mw->network->get_rng())());
+    ens.set_progress(&progress);
+    if (cb) {
+        ens.run_chain_binomial(reps, cb->get_infectious_period(), cb->get_transmissibility(), patient_zero_ct);
+    } else {
+        ens.run_percolation(reps, perc->T, patient_zero_ct);
+    }
+    sizes.swap(ens.get_epidemic_sizes());
+    epi_curves.swap(ens.get_epi_curves());
+    return true;
+}
@@ -2,7 +2,11 @@
 #define BAKGROUNDTHREAD
 
 #include <QThread>
+#include <atomic>
 #include "mainWindow.h"
+#include "workerPool.h"
+#include "../src/Progress.h"
+#include "../src/Ensemble.h"
 
 
 class MainWindow;
@@ -13,10 +17,13 @@ Q_OBJECT
     public:
 
         BackgroundThread(MainWindow* w);
+        ~BackgroundThread();
 
-        enum ThreadType { GENERATE_NET, COMPONENTS, TRANSITIVITY, DISTANCES, SIMULATE };
+        enum ThreadType { GENERATE_NET, COMPONENTS, TRANSITIVITY, DISTANCES, COMMUNITIES, SIMULATE };
         void setThreadType(ThreadType t) { type=t; }
         bool stopped() { return _stopped; }
+        WorkerPool* workerPool() { return pool; }
+        void reportProgress() { emit setProgressValue(pool->percentDone()); }
 
     public slots:
         void stop();
@@ -32,12 +39,19 @@ Q_OBJECT
 
     protected:
         void run(void);
+        void timerEvent(QTimerEvent*);
 
     private:
-        volatile bool _stopped;
+        atomic<bool> _stopped;
         ThreadType type;
         MainWindow* mw;
+        WorkerPool* pool;
+        Progress progress;      // reported to by network methods; polled by the timer
+        int _progressTimerID;
+        int _lastPhase;
+        long _lastDone;
         void runSimulation();
+        bool runEnsemble(int reps, int patient_zero_ct, vector<int>& sizes, vector< vector<int> >& epi_curves);
 };
 
 #endif
@@ -1,7 +0,0 @@
-#include "debug.h"
-
-void __update_progress(float x) {
-    __mainWindow->updateProgress(x);
-}
-
-    
@@ -7,17 +7,19 @@ HEADERS     = mainWindow.h \
              plotView.h \
              plotAxis.h \
              plotPoint.h \
+             plotCurves.h \
+             stateHistory.h \
              plotScene.h \ 
              plotRegion.h \
              plotText.h \
              node.h \
              edge.h \
              graphwidget.h \
-             debug.h \
              analysisDialog.h \
              ForceLayout.h \
              Quadtree.h \
              backgroundthread.h \
+             workerPool.h \
              codeeditor.h \
              textEditorDialog.h
 
@@ -28,13 +30,15 @@ HEADERS     = mainWindow.h \
                plotScene.cpp \
                plotAxis.cpp \
                plotPoint.cpp  \
+               plotCurves.cpp \
+               stateHistory.cpp \
                plotRegion.cpp \
                node.cpp \
                edge.cpp \
                graphwidget.cpp \
-               debug.cpp \
                analysisDialog.cpp \
                backgroundthread.cpp \
+               workerPool.cpp \
                ForceLayout.cpp \
                quadtree.cpp \
                codeeditor.cpp \
@@ -68,6 +68,7 @@ void MyScene::mouseReleaseEvent ( QGraphicsSceneMouseEvent * mouseEvent ) {
 
 void GraphWidget::clear() {
     nodelist.clear();
+    _forceLayout.invalidate();
     scene()->clear();
 }
 
@@ -78,6 +79,7 @@ GNode* GraphWidget::addGNode(int id){//, void* data) {
         n->setId(id);
         n->setGraphWidget(this);
         nodelist.push_back(n);
+        _forceLayout.invalidate();
         return n;
     } else {
         return nodelist[id];
@@ -110,6 +112,7 @@ GEdge* GraphWidget::addGEdge(GNode* n1, GNode* n2, string note, void* data) {
     n1->addGEdge(e);
     n2->addGEdge(e);
     scene()->addItem(e);
+    _forceLayout.invalidate();
     return(e);
 }
 
@@ -172,12 +175,10 @@ void GraphWidget::newLayout() {
 }
 
 void GraphWidget::forceLayout(int iterations=1) {
-    ForceLayout layout;
-
     QRectF r = scene()->sceneRect();
     double s = 0.95; // shrink plot region used
-    layout.set_dimensions(s*r.left(), s*r.right(), s*r.top(), s*r.bottom());
-    layout.doLayout(nodelist, iterations);
+    _forceLayout.set_dimensions(s*r.left(), s*r.right(), s*r.top(), s*r.bottom());
+    _forceLayout.doLayout(nodelist, iterations);
 
     invalidateScene();
 }
@@ -264,17 +265,29 @@ void GraphWidget::timerEvent(QTimerEvent* event) {
         QRgb colors[4] = { qRgb(0, 0, 200), qRgb(254, 0, 0), qRgb(254, 254, 0), qRgb(254,254,254) };
         QColor col = Qt::gray;
 
-        if (nodeStates.size() > _animationTime) {
-            for (unsigned int id = 0; id < nodeStates[_animationTime].size(); ++id) {
-                int state = nodeStates[_animationTime][id] == -1 ? 2 :
-                            nodeStates[_animationTime][id] ==  0 ? 0 : 1;
+        if ((unsigned) nodeStates.size() > _animationTime) {
+            // every frame is a list of the nodes that changed state, so only
+            // those are recolored and repainted, except when starting over
+            if (_animationTime == 0) {
+                foreach(GNode* node, nodelist) {
+                    node->setBrush(QColor(colors[0]));
+                    node->update();
+                }
+            }
+            const int* ids = nodeStates.changedNodes(_animationTime);
+            const int* vals = nodeStates.changedStates(_animationTime);
+            for (int i = 0; i < nodeStates.changeCount(_animationTime); ++i) {
+                int state = vals[i] == -1 ? 2 :
+                            vals[i] ==  0 ? 0 : 1;
                 col = colors[state];
-                GNode* node = locateGNode(id);
-                if (node) node->setBrush(col);
+                GNode* node = locateGNode(ids[i]);
+                if (node) {
+                    node->setBrush(col);
+                    node->update();
+                }
             }
-            invalidateScene();
 
-            if (++_animationTime >= nodeStates.size()) _animationTime = 0;
+            if (++_animationTime >= (unsigned) nodeStates.size()) _animationTime = 0;
         }
     } else {
         forceLayout(1);
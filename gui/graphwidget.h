@@ -11,6 +11,7 @@
 
 #include "Quadtree.h"
 #include "ForceLayout.h"
+#include "stateHistory.h"
 
 #include "node.h"
 #include "edge.h"
@@ -87,7 +88,7 @@ public slots:
 	void removeSelectedGNodes();
     void animateNetwork();
     void relaxNetwork();
-    void setNodeStates(vector< vector<int> > states) { nodeStates = states; _animationTime=0; }
+    void setNodeStates(const StateHistory& states) { nodeStates = states; _animationTime=0; }
     void clearNodeStates(){ nodeStates.clear(); }
     void recenterItems();
     void saveData();
@@ -106,6 +107,7 @@ protected:
 private:
 	//graph layout
 	LayoutAlgorithm	  _layoutAlgorithm;
+    ForceLayout _forceLayout;   // kept between frames, for its arrays and quadtree
 
     void timerEvent(QTimerEvent*);
 
@@ -115,7 +117,7 @@ private:
     int   _layoutTimerID;
     int   _animationCounter;
 
-    vector< vector<int> > nodeStates;
+    StateHistory nodeStates;
     double _zoomFactor;
 
     QAction* savePlotAction;
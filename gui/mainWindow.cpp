@@ -507,6 +507,7 @@ void MainWindow::readEdgeList() {
 
     if(network) { delete(network); }
     netComponents.clear();
+    netCommunities.clear();
 
     setCursor(Qt::WaitCursor);
     appendOutputLine("Importing network . . . ");
@@ -764,6 +765,7 @@ void MainWindow::clear_data() {
 void MainWindow::clear_network() {
     if(network) network->clear_nodes();
     netComponents.clear();
+    netCommunities.clear();
     updateRZero();
     appendOutputLine("Network deleted");
     runSimulationButton->setEnabled(false);
@@ -899,20 +901,20 @@ void MainWindow::simulatorWrapper() {
     if ( rightBox->sizes()[0] > 0) statePlot->replot(); // b/c stateplot uses epicurve axis
     if ( rightBox->sizes()[2] > 0) histPlot->replot();
     if ( resultsAnalysisDialog->isVisible() ) resultsAnalysisDialog->updateResultsAnalysis();
-    networkPlot->setNodeStates(statePlot->getData());
+    networkPlot->setNodeStates(statePlot->getStateHistory());
     if ( networkPlot->isVisible() ) networkPlot->animateNetwork();
 
 }
 
 
 void MainWindow::addStateData() {
-    vector<int> node_states(maxNodesToPlot);
+    // only nodes that changed state since the last call are stored
+    StateHistory& history = statePlot->getStateHistory();
+    history.addFrame();
     vector<Node*> nodelist = network->get_nodes();
-    for (int i = 0; i < network->size() && (unsigned) i < node_states.size(); i++) {
-        node_states[i] = (int) nodelist[i]->get_state();
+    for (int i = 0; i < network->size() && i < maxNodesToPlot; i++) {
+        history.setState(i, (int) nodelist[i]->get_state());
     }
-
-    statePlot->addData(node_states);
 }
 
 void MainWindow::updatePlotMenuFlags() {
@@ -1074,6 +1076,7 @@ void MainWindow::removeMinorComponents() {
         }
         netComponents.clear();
         netComponents.push_back(giant);
+        netCommunities.clear();
 
         numnodesLine->setText(QString::number(network->size()));
         updateRZero();
@@ -1094,6 +1097,7 @@ void MainWindow::generate_network_thread() {
 
     if(network) delete(network);
     netComponents.clear();
+    netCommunities.clear();
     netfileLine->setText("");
 
     int n = (numnodesLine->text()).toInt();
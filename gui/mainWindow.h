@@ -1,7 +1,6 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 #define QT_USE_FAST_CONCATENATION
-#define PROG(x) cerr << x << endl
 
 #include <QtGui>
 #include <QApplication>
@@ -21,7 +20,6 @@
 #include <QCheckBox>
 #include <QFileDialog>
 
-#include "debug.h"
 #include "plotView.h"
 #include "graphwidget.h"
 #include "backgroundthread.h"
@@ -110,6 +108,7 @@ class MainWindow : public QMainWindow
         enum DistType  { POI, EXP, POW, URB, CON, SMW};
         int rep_ct;
         vector< vector<Node*> > netComponents;
+        vector< vector<Node*> > netCommunities;
         void updateProgress(int x);
 
     signals:
@@ -0,0 +1,120 @@
+#include "plotCurves.h"
+#include <math.h>
+
+const int CURVE_HALF_WIDTH = 1; // curves are drawn 2*CURVE_HALF_WIDTH + 1 pixels thick
+
+void CurveRaster::addCurve(const vector<int>& curve) {
+    values.insert(values.end(), curve.begin(), curve.end());
+    offsets.push_back(values.size());
+    for (unsigned int j = 0; j < curve.size(); j++) {
+        if (curve[j] > max_value) max_value = curve[j];
+    }
+    if ((int) curve.size() > max_length) max_length = curve.size();
+}
+
+
+void CurveRaster::clear() {
+    values.clear();
+    offsets.assign(1, 0);
+    max_value = 0;
+    max_length = 0;
+    W = H = 0;
+    xMax = yMax = 0;
+    drawn = 0;
+    density.clear();
+}
+
+
+// Finds the rows curve i covers in each pixel column, connecting consecutive
+// time steps with straight lines, and adds them to the density raster.
+void CurveRaster::rasterize(int i) {
+    const int* v = curve(i);
+    const int L = length(i);
+    spanLo.assign(W, H);
+    spanHi.assign(W, -1);
+    if (L == 0) return;
+
+    const float sx = W / xMax;
+    const float sy = H / yMax;
+    for (int j = 0; j < L; j++) {
+        const float x0 = j * sx;
+        const float y0 = H - v[j] * sy;
+        const float x1 = j + 1 < L ? (j + 1) * sx : x0;
+        const float y1 = j + 1 < L ? H - v[j+1] * sy : y0;
+        const int c0 = (int) x0;
+        const int c1 = (int) x1;
+        for (int c = c0; c <= c1 and c < W; c++) {
+            // the segment's extent within column c
+            float ya = y0, yb = y1;
+            if (x1 > x0) {
+                const float xa = c > x0 ? c : x0;
+                const float xb = c + 1 < x1 ? c + 1 : x1;
+                ya = y0 + (y1 - y0) * (xa - x0) / (x1 - x0);
+                yb = y0 + (y1 - y0) * (xb - x0) / (x1 - x0);
+            }
+            int lo = (int) floor(ya < yb ? ya : yb) - CURVE_HALF_WIDTH;
+            int hi = (int) floor(ya < yb ? yb : ya) + CURVE_HALF_WIDTH;
+            if (lo < spanLo[c]) spanLo[c] = lo < 0 ? 0 : lo;
+            if (hi > spanHi[c]) spanHi[c] = hi >= H ? H - 1 : hi;
+        }
+    }
+
+    for (int c = 0; c < W; c++) {
+        for (int r = spanLo[c]; r <= spanHi[c]; r++) density[r * W + c]++;
+    }
+}
+
+
+QImage CurveRaster::render(int w, int h, double xmax, double ymax) {
+    QImage image(w, h, QImage::Format_ARGB32);
+    image.fill(qRgba(0, 0, 0, 0));
+    if (w <= 0 or h <= 0 or xmax <= 0 or ymax <= 0 or size() == 0) return image;
+
+    if (w != W or h != H or xmax != xMax or ymax != yMax) {
+        W = w;
+        H = h;
+        xMax = xmax;
+        yMax = ymax;
+        density.assign(W * H, 0);
+        drawn = 0;
+    }
+    if (drawn < size()) {
+        for (int i = drawn; i < size(); i++) rasterize(i);
+        drawn = size();
+    }
+
+    // per-curve opacity, as when each time step was drawn as its own point
+    const int n = size();
+    int alpha;
+    if (n < 2) {
+        alpha = 255;
+    } else if (n > 25) {
+        alpha = 10;
+    } else {
+        alpha = 255 / n;
+    }
+
+    // opacity of k curves on top of one another
+    unsigned int max_ct = 0;
+    for (unsigned int p = 0; p < density.size(); p++) {
+        if (density[p] > max_ct) max_ct = density[p];
+    }
+    vector<QRgb> shade(max_ct + 1);
+    for (unsigned int k = 0; k <= max_ct; k++) {
+        shade[k] = qRgba(0, 0, 0, (int) (255 * (1.0 - pow(1.0 - alpha / 255.0, (double) k)) + 0.5));
+    }
+
+    for (int r = 0; r < H; r++) {
+        QRgb* line = (QRgb*) image.scanLine(r);
+        const unsigned int* row = &density[r * W];
+        for (int c = 0; c < W; c++) line[c] = shade[ row[c] ];
+    }
+
+    // spanLo/spanHi still hold the most recent curve
+    const QRgb recent = qRgba(255, 0, 0, 255);
+    for (int c = 0; c < W; c++) {
+        for (int r = spanLo[c]; r <= spanHi[c]; r++) ((QRgb*) image.scanLine(r))[c] = recent;
+    }
+
+    return image;
+}
@@ -0,0 +1,57 @@
+#ifndef PLOT_CURVES_H
+#define PLOT_CURVES_H
+
+#include <QImage>
+#include <vector>
+
+using namespace std;
+
+/******************************************************************************
+ * Storage and rendering for the epidemic curve plot.  Replicate curves are
+ * kept back to back in one array (curve i is values[offsets[i]] ..
+ * values[offsets[i+1]-1]) rather than as one vector, or one graphics item,
+ * per curve.
+ *
+ * render() draws them into an image of the plot area.  Each curve is
+ * downsampled to pixel columns, and adds one hit to each pixel it crosses in a
+ * density raster; the raster is then turned into a grey image in which a pixel
+ * covered by k curves has the opacity of k overlapping translucent curves, and
+ * the most recent curve is drawn on top in red.  The raster is kept between
+ * calls, and only curves added since the last call are rasterized unless the
+ * image size or the axis ranges have changed, so redrawing costs O(width x
+ * height) rather than O(data).
+ *****************************************************************************/
+
+class CurveRaster {
+    public:
+        CurveRaster() { clear(); }
+
+        void addCurve(const vector<int>& curve);
+        void clear();
+
+        int size() const { return offsets.size() - 1; }
+        int length(int i) const { return offsets[i+1] - offsets[i]; }
+        const int* curve(int i) const { return values.data() + offsets[i]; }
+        int maxValue() const { return max_value; }
+        int maxLength() const { return max_length; }
+
+        // plot area of w x h pixels, showing [0, xmax] x [0, ymax]
+        QImage render(int w, int h, double xmax, double ymax);
+
+    private:
+        vector<int> values;
+        vector<int> offsets;
+        int max_value;
+        int max_length;
+
+        // density raster, valid for this geometry
+        int W, H;
+        double xMax, yMax;
+        int drawn;                  // curves already counted in density
+        vector<unsigned int> density;
+        vector<int> spanLo, spanHi; // rows covered in each column by the last curve rasterized
+
+        void rasterize(int i);
+};
+
+#endif
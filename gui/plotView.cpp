@@ -61,47 +61,6 @@ void PlotView::replot() {
 }
 
 
-int find_min_val(vector< vector <int> > data) {
-    int minY = INT_MAX;
-    for( unsigned int i=0; i < data.size(); i++ ) {
-        for( unsigned int j=0; j < data[i].size(); j++ ) {
-            int test_min = data[i][j];
-            if (test_min < minY) {
-                minY = test_min;
-            }
-        }
-    }
-    return minY;
-}
-
-
-
-int find_max_val(vector< vector <int> > data) {
-    int maxY = 0;
-    for( unsigned int i=0; i < data.size(); i++ ) {
-        for( unsigned int j=0; j < data[i].size(); j++ ) {
-            int test_max = data[i][j];
-            if (test_max > maxY) {
-                maxY = test_max;
-            }
-        }
-    }
-    return maxY;
-}
-
-
-int find_max_idx(vector< vector <int> > data) {
-    int maxX = 0;
-    for( unsigned int i=0; i < data.size(); i++ ) {
-        int test_max = data[i].size() - 1;
-        if (test_max > maxX) {
-            maxX = test_max;
-        }
-    }
-    return maxX;
-}
-
-
 void PlotView::debugger() { // makes it easier to see what's going on with coordinates & plot area
     // debugging data
         node_states.clear();
@@ -244,16 +203,12 @@ void PlotView::drawHistogram() {
     
  
 void PlotView::drawEpiCurvePlot() {
-    if (node_states.size() == 0 ) {
-        clearPlot();
-        return;
-    }
-        
-    setRenderHint(QPainter::Antialiasing); // smooth data points
+    clearPlot();
+    if (curves.size() == 0) return;
+
+    int max_val = curves.maxValue();
+    int max_idx = curves.maxLength() - 1;
 
-    float max_val = (float) find_max_val(node_states);
-    int   max_idx = find_max_idx(node_states);
-    
     epiCurveAxisUpdated((double) max_idx);
 
     Axis* xAxis = myscene->xAxis;
@@ -269,49 +224,14 @@ void PlotView::drawEpiCurvePlot() {
     myscene->setXrange(0,xAxis->getMax());
     myscene->setYrange(0,yAxis->getMax());
 
-    float r = 3;                 // radius of data points
-    qreal zval = 0;
-    
-    int alpha;
-    int alpha_threshold[2] = {2, 25};
-    if ((signed) node_states.size() < alpha_threshold[0]) {
-        alpha = 255;
-    }
-    else if ((signed) node_states.size() > alpha_threshold[1]) {
-        alpha = 10;
-    }
-    else {
-        alpha = 255 / node_states.size();
-    }
-
-    QColor default_color(0,0,0,alpha);
-    QBrush brush(default_color);
-
-    foreach(QGraphicsItem* item, myscene->dataArea->childItems() ) {
-        if (Point* p = qgraphicsitem_cast<Point*>(item)) {
-            p->setBrush(brush);
-            p->updatePosition();
-        }
-    }
-
-    QColor recent_color = Qt::red;
-    for( int i = newDataCursor; i < (signed) node_states.size(); i++ ) {
-        if (i == (signed) node_states.size() - 1) {
-            brush.setColor(recent_color);
-            zval = 1;
-        }
-        for( unsigned int j=0; j<node_states[i].size(); j++ ) {
-            Point*  dot = new Point( j, node_states[i][j] , r);
-            dot->setParentItem(myscene->dataArea);
-            dot->setBrush(brush);
-            dot->updatePosition();
-            dot->setZValue(zval);
-        }
-    }
-    
-    newDataCursor = node_states.size();
-    myscene->update();
+    // one image for all curves; only new curves are rasterized, unless the
+    // widget was resized or an axis range changed
+    int W = myscene->dataArea->width();
+    int H = myscene->dataArea->height();
+    QImage image = curves.render(W, H, xAxis->getMax(), yAxis->getMax());
 
+    QGraphicsPixmapItem* mypixmap = new QGraphicsPixmapItem(QPixmap::fromImage(image));
+    mypixmap->setParentItem(myscene->dataArea);
 }
 
 void PlotView::drawNodeStatePlot() {
@@ -319,14 +239,14 @@ void PlotView::drawNodeStatePlot() {
     clearPlot();
     QRgb colors[4] = { qRgb(0, 0, 200), qRgb(254, 0, 0), qRgb(254, 254, 0), qRgb(254,254,254) };
 
-    if (node_states.size() == 0 ) {
+    if (states.size() == 0 ) {
         clearPlot();
         return;
     }
     
-    int node_ct = (signed) node_states[0].size();
+    int node_ct = states.numNodes();
     node_ct = node_ct > 100 ? 100 : node_ct;
-    int duration = (signed) node_states.size() - 1;
+    int duration = states.size() - 1;
     int xmax = rangeMax > duration? rangeMax : duration;
 
     Axis* xAxis = myscene->xAxis;
@@ -350,9 +270,11 @@ void PlotView::drawNodeStatePlot() {
     QRgb value;
     QImage image(xmax,  node_ct,QImage::Format_ARGB32);
     image.fill(Qt::white);
-    for( int x=0; x < (signed) node_states.size(); x++) {
+    vector<int> frame;
+    for( int x=0; x < states.size(); x++) {
+        states.applyFrame(frame, x);
         for( int y=0; y < node_ct; y++ ) {
-             int val = node_states[x][y];
+             int val = frame[y];
              
              if (val == 0) {}
              else if (val == -1) { val = 2; }
@@ -376,7 +298,6 @@ void PlotView::drawNodeStatePlot() {
 
 
 void PlotView::resizeEvent ( QResizeEvent * ) {
-    newDataCursor = 0;
     myscene->setSceneRect(0,0,width(),height()); //set scene to parent widget width x height
     clearPlot();
     replot();
@@ -384,8 +305,10 @@ void PlotView::resizeEvent ( QResizeEvent * ) {
 
 
 void PlotView::addData( vector<int> X ) { 
-    if (plotType == STATEPLOT or plotType == CURVEPLOT) {
-        node_states.push_back(X);
+    if (plotType == CURVEPLOT) {
+        curves.addCurve(X);
+    } else if (plotType == STATEPLOT) {
+        states.addFrame(X);
     } else {
         if (node_states.empty()) {
             vector<int> nothing;
@@ -402,8 +325,28 @@ void PlotView::clearPlot() {
 
 void PlotView::clearData() {
     node_states.clear();
-    recentDataCursor = 0;
-    newDataCursor = 0;
+    curves.clear();
+    states.clear();
+}
+
+
+vector< vector<int> > PlotView::getData() {
+    if (plotType == CURVEPLOT) {
+        vector< vector<int> > data(curves.size());
+        for (int i = 0; i < curves.size(); i++) {
+            data[i].assign(curves.curve(i), curves.curve(i) + curves.length(i));
+        }
+        return data;
+    } else if (plotType == STATEPLOT) {
+        vector< vector<int> > data(states.size());
+        vector<int> frame(states.numNodes(), 0);
+        for (int t = 0; t < states.size(); t++) {
+            states.applyFrame(frame, t);
+            data[t] = frame;
+        }
+        return data;
+    }
+    return node_states;
 }
 
 void PlotView::saveData() {
@@ -416,19 +359,27 @@ void PlotView::saveData() {
 
     if ( plotType == CURVEPLOT ) {
         // One time series per line
-        for( unsigned int r=0; r < node_states.size(); r++) {
-            for( unsigned int c=0; c < node_states[r].size() - 1; c++ ) {
-                out << node_states[r][c] << ",";
+        for( int r=0; r < curves.size(); r++) {
+            const int* curve = curves.curve(r);
+            for( int c=0; c < curves.length(r) - 1; c++ ) {
+                out << curve[c] << ",";
             }
-            out << node_states[r][node_states[r].size()-1] << endl;
+            out << curve[curves.length(r)-1] << endl;
         }
     } else if (plotType == STATEPLOT ) { 
-        // Swap rows and columns -- data structure must be rectangular!
-        for( unsigned int r=0; r < node_states[0].size(); r++ ) {
-            for( unsigned int c=0; c < node_states.size() - 1; c++) {
-                out << node_states[c][r] << ",";
+        // One node per line, for the first 100 nodes
+        int node_ct = states.numNodes() > 100 ? 100 : states.numNodes();
+        vector< vector<int> > rows(node_ct);
+        vector<int> frame;
+        for( int c=0; c < states.size(); c++) {
+            states.applyFrame(frame, c);
+            for( int r=0; r < node_ct; r++ ) rows[r].push_back(frame[r]);
+        }
+        for( int r=0; r < node_ct; r++ ) {
+            for( unsigned int c=0; c < rows[r].size() - 1; c++) {
+                out << rows[r][c] << ",";
             }
-            out << node_states[node_states.size()-1][r] << endl;
+            out << rows[r][rows[r].size()-1] << endl;
         }
     } else if (plotType == HISTPLOT || plotType == DEGPLOT || plotType == RESULTS_HISTPLOT) {
         // One number per line
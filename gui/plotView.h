@@ -14,6 +14,8 @@
 #include "plotScene.h"
 #include "plotPoint.h"
 #include "plotRegion.h"
+#include "plotCurves.h"
+#include "stateHistory.h"
 
 
 using namespace std;
@@ -31,7 +33,8 @@ class PlotView : public QGraphicsView
         PlotType getPlotType() { return plotType; }
 
         void debugger();
-        vector< vector<int> > getData() { return node_states; }
+        vector< vector<int> > getData();
+        StateHistory& getStateHistory() { return states; }  // STATEPLOT
         int default_nbins(double rangeMin, double rangeMax);
         vector<double> default_minmax();
 
@@ -64,7 +67,9 @@ class PlotView : public QGraphicsView
 
     private:
 
-        vector< vector<int> > node_states;
+        vector< vector<int> > node_states; // histogram plot types
+        CurveRaster curves;                 // CURVEPLOT
+        StateHistory states;                // STATEPLOT
 
         PlotType plotType;
         double rangeMin;
@@ -74,9 +79,6 @@ class PlotView : public QGraphicsView
         PlotScene* myscene;
         QAction* savePlotAction;
         QAction* saveDataAction;
-        
-        int newDataCursor;  // starting position of data that has never been plotted
-        int recentDataCursor; // starting position of data from most recent run
 
         void mouseDoubleClickEvent (QMouseEvent*) { savePlot(); }
 };
@@ -1,17 +1,22 @@
 #include "Quadtree.h"
 
-Quadtree::Quadtree(QVector<Particle *> &particles) {
+void Quadtree::build(const std::vector<double>& x, const std::vector<double>& y) {
+    px = x.data();
+    py = y.data();
+    nodes.clear();
+    if (x.empty()) return;
+
     /* Compute bounds. */
     double x1 = std::numeric_limits<double>::max();
     double y1 = x1;
-    double x2 = std::numeric_limits<double>::min();
+    double x2 = std::numeric_limits<double>::lowest();
     double y2 = x2;
 
-    for (auto p: particles) {
-        if (p->x() < x1) x1 = p->x();
-        if (p->y() < y1) y1 = p->y();
-        if (p->x() > x2) x2 = p->x();
-        if (p->y() > y2) y2 = p->y();
+    for (unsigned int i = 0; i < x.size(); i++) {
+        if (x[i] < x1) x1 = x[i];
+        if (y[i] < y1) y1 = y[i];
+        if (x[i] > x2) x2 = x[i];
+        if (y[i] > y2) y2 = y[i];
     }
 
     /* Squarify the bounds. */
@@ -27,68 +32,62 @@ Quadtree::Quadtree(QVector<Particle *> &particles) {
     xMax = x2;
     yMax = y2;
 
-
     /* Insert all particles. */
-    root = new QuadtreeNode();
-    for (auto p: particles) insert(this->root, p, x1, y1, x2, y2);
-
-    //root->print();
+    nodes.push_back(QuadtreeNode());
+    for (unsigned int i = 0; i < x.size(); i++) insert(i);
 }
 
 /**
- * @ignore Recursively inserts the specified particle <i>p</i> into a
- * descendant of node <i>n</i>. The bounds are defined by [<i>x1</i>,
- * <i>x2</i>] and [<i>y1</i>, <i>y2</i>].
+ * @ignore Returns the child of node <i>n</i> in whose quadrant particle
+ * <i>p</i> lies, creating it if needed, and narrows the bounds [<i>x1</i>,
+ * <i>x2</i>] and [<i>y1</i>, <i>y2</i>] to that quadrant.
  */
-void Quadtree::insertChild( QuadtreeNode* n, Particle* p, double x1, double y1, double x2, double y2 ) {
+int Quadtree::child( int n, int p, double& x1, double& y1, double& x2, double& y2 ) {
     /* Compute the split point, and the quadrant in which to insert p. */
     double sx = (x1 + x2) * .5;
     double sy = (y1 + y2) * .5;
-    bool  right = p->x() >= sx;
-    bool bottom = p->y() >= sy;
+    bool  right = px[p] >= sx;
+    bool bottom = py[p] >= sy;
+    int quadrant = ((int) bottom << 1) + (int) right;
 
-    /* Recursively insert into the child node. */
-    n->leaf = false;
-    switch (((int) bottom << 1) + (int) right) {
-        case 0: n = n->c1 ? n->c1 : (n->c1 = new QuadtreeNode()); break;
-        case 1: n = n->c2 ? n->c2 : (n->c2 = new QuadtreeNode()); break;
-        case 2: n = n->c3 ? n->c3 : (n->c3 = new QuadtreeNode()); break;
-        case 3: n = n->c4 ? n->c4 : (n->c4 = new QuadtreeNode()); break;
+    nodes[n].leaf = false;
+    if (nodes[n].c[quadrant] < 0) {
+        nodes.push_back(QuadtreeNode());
+        nodes[n].c[quadrant] = nodes.size() - 1;
     }
 
-    /* Update the bounds as we recurse. */
+    /* Update the bounds as we descend. */
     if (right) x1 = sx; else x2 = sx;
     if (bottom) y1 = sy; else y2 = sy;
-    insert(n, p, x1, y1, x2, y2);
+    return nodes[n].c[quadrant];
 }
 
 /**
- * @ignore Recursively inserts the specified particle <i>p</i> at the node
- * <i>n</i> or one of its descendants. The bounds are defined by [<i>x1</i>,
- * <i>x2</i>] and [<i>y1</i>, <i>y2</i>].
+ * @ignore Inserts particle <i>p</i> at the root or one of its descendants.
  */
-void Quadtree::insert( QuadtreeNode* n, Particle* p, double x1, double y1, double x2, double y2 ) {
-    //std::cerr << "insert: " << n << " " << p->x <<"," << p->y << std::endl;
-    if (n->leaf) {
-        if (n->p) {
+void Quadtree::insert( int p ) {
+    int n = 0;
+    double x1 = xMin, y1 = yMin, x2 = xMax, y2 = yMax;
+    while (true) {
+        if (nodes[n].leaf) {
+            const int v = nodes[n].p;
+            if (v < 0) {
+                nodes[n].p = p;
+                return;
+            }
             /*
              * If the particle at this leaf node is at the same position as the new
              * particle we are adding, we leave the particle associated with the
              * internal node while adding the new particle to a child node. This
              * avoids infinite recursion.
              */
-            if ((fabs(n->p->x() - p->x()) + fabs(n->p->y() - p->y())) < .01) {
-                insertChild(n, p, x1, y1, x2, y2);
-            } else {
-                Particle* v = n->p;
-                n->p = nullptr;
-                insertChild(n, v, x1, y1, x2, y2);
-                insertChild(n, p, x1, y1, x2, y2);
+            if ((fabs(px[v] - px[p]) + fabs(py[v] - py[p])) >= .01) {
+                nodes[n].p = -1;
+                double vx1 = x1, vy1 = y1, vx2 = x2, vy2 = y2;
+                const int c = child(n, v, vx1, vy1, vx2, vy2);
+                nodes[c].p = v;
             }
-        } else {
-            n->p = p;
         }
-    } else {
-        insertChild(n, p, x1, y1, x2, y2);
+        n = child(n, p, x1, y1, x2, y2);
     }
 }
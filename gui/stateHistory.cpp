@@ -0,0 +1,44 @@
+#include "stateHistory.h"
+
+void StateHistory::clear() {
+    current.clear();
+    changeNode.clear();
+    changeState.clear();
+    offsets.assign(1, 0);
+}
+
+
+void StateHistory::addFrame() {
+    offsets.push_back(changeNode.size());
+}
+
+
+void StateHistory::setState(int node, int state) {
+    if (node >= (int) current.size()) current.resize(node + 1, 0);
+    if (current[node] == state) return;
+    current[node] = state;
+    changeNode.push_back(node);
+    changeState.push_back(state);
+    offsets.back() = changeNode.size();
+}
+
+
+void StateHistory::addFrame(const vector<int>& states) {
+    addFrame();
+    for (unsigned int i = 0; i < states.size(); i++) setState(i, states[i]);
+}
+
+
+vector<int> StateHistory::getFrame(int t) const {
+    vector<int> states(numNodes(), 0);
+    for (int f = 0; f <= t; f++) applyFrame(states, f);
+    return states;
+}
+
+
+void StateHistory::applyFrame(vector<int>& states, int t) const {
+    if ((int) states.size() < numNodes()) states.resize(numNodes(), 0);
+    const int* nodes = changedNodes(t);
+    const int* values = changedStates(t);
+    for (int i = 0; i < changeCount(t); i++) states[ nodes[i] ] = values[i];
+}
@@ -0,0 +1,53 @@
+#ifndef STATE_HISTORY_H
+#define STATE_HISTORY_H
+
+#include <vector>
+
+using namespace std;
+
+/******************************************************************************
+ * Node states over the course of a simulation, stored as transitions.  Each
+ * frame (time step) records only the nodes whose state differs from the
+ * previous frame, as (node, new state) pairs; every node is in state 0 before
+ * the first frame.  Changes are kept back to back in two arrays, and the
+ * changes of frame t are entries offsets[t] .. offsets[t+1]-1.
+ *
+ * A run over n nodes with c transitions in total takes O(n + c) memory, rather
+ * than O(n x frames).  Frames are rebuilt on demand: getFrame() for any one,
+ * or applyFrame() to step a state vector forward one frame at a time.
+ *****************************************************************************/
+
+class StateHistory {
+    public:
+        StateHistory() { clear(); }
+
+        void clear();
+
+        // Start a new frame, then set the state of every node (or only the
+        // ones that may have changed) with setState().
+        void addFrame();
+        void setState(int node, int state);
+        void addFrame(const vector<int>& states);
+
+        int size() const { return offsets.size() - 1; }     // number of frames
+        int numNodes() const { return current.size(); }
+        int numChanges() const { return changeNode.size(); }
+
+        // transitions into frame t
+        int changeCount(int t) const { return offsets[t+1] - offsets[t]; }
+        const int* changedNodes(int t) const { return changeNode.data() + offsets[t]; }
+        const int* changedStates(int t) const { return changeState.data() + offsets[t]; }
+
+        // states at frame t
+        vector<int> getFrame(int t) const;
+        // updates states (at frame t-1, or all 0 for t == 0) to frame t
+        void applyFrame(vector<int>& states, int t) const;
+
+    private:
+        vector<int> current;        // states at the last frame
+        vector<int> changeNode;
+        vector<int> changeState;
+        vector<int> offsets;
+};
+
+#endif
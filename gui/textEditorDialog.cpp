@@ -73,6 +73,7 @@ for (unsigned int i = 0; i<normed_dist.size(); ++i) cerr << "deg, freq: " << i <
 
     if(mw->network) { delete(mw->network); }
     mw->netComponents.clear();
+    mw->netCommunities.clear();
     int netSize = mw->numnodesLine->text().toInt();
 
     setCursor(Qt::WaitCursor);
@@ -0,0 +1,66 @@
+#include "workerPool.h"
+
+WorkerPool::WorkerPool(int threads) : generation(0), active(0), quit(false), job_chunks(0),
+                                      next_chunk(0), total(0), done(0), cancelled_flag(false) {
+    if (threads < 1) threads = thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+    for (int w = 0; w < threads; w++) workers.push_back(thread(&WorkerPool::work, this, w));
+}
+
+
+WorkerPool::~WorkerPool() {
+    cancel();
+    {
+        lock_guard<mutex> lock(m);
+        quit = true;
+    }
+    wake.notify_all();
+    for (unsigned int w = 0; w < workers.size(); w++) workers[w].join();
+}
+
+
+void WorkerPool::run(int chunks, function<void(int, int)> task, function<void()> tick, int tick_ms) {
+    lock_guard<mutex> serial(run_mutex);
+    unique_lock<mutex> lock(m);
+    job = task;
+    job_chunks = chunks;
+    next_chunk = 0;
+    active = workers.size();
+    generation++;
+    wake.notify_all();
+
+    while (not finished.wait_for(lock, chrono::milliseconds(tick_ms), [this]() { return active == 0; })) {
+        if (tick) {
+            lock.unlock();
+            tick();
+            lock.lock();
+        }
+    }
+    job = nullptr;
+}
+
+
+int WorkerPool::percentDone() const {
+    const long n = total.load(memory_order_relaxed);
+    if (n <= 0) return 0;
+    const long d = done.load(memory_order_relaxed);
+    return d >= n ? 100 : (int) (100 * d / n);
+}
+
+
+void WorkerPool::work(int w) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(m);
+            wake.wait(lock, [&]() { return quit or generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+
+        for (int c = next_chunk++; c < job_chunks and not cancelled(); c = next_chunk++) job(c, w);
+
+        lock_guard<mutex> lock(m);
+        if (--active == 0) finished.notify_all();
+    }
+}
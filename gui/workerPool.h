@@ -0,0 +1,66 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/******************************************************************************
+ * A fixed set of worker threads, one per core by default, for splitting
+ * background work (simulation replicates, per-node analyses) into chunks.
+ *
+ * run() hands out chunk numbers to the workers until none are left, and blocks
+ * until they are all done; meanwhile the calling thread wakes every tick_ms to
+ * run tick(), e.g. to report progress.  Progress is a pair of atomic counters
+ * that tasks bump with addDone(), so reporting it takes no locks.
+ *
+ * Cancellation is cooperative: after cancel(), no more chunks are started, and
+ * running tasks are expected to check cancelled() often enough to return
+ * within a few milliseconds.  The flag stays set until reset().
+ *****************************************************************************/
+
+class WorkerPool {
+    public:
+        WorkerPool(int threads = 0);    // 0: one per core
+        ~WorkerPool();
+
+        int size() const { return workers.size(); }
+
+        // task(chunk, worker) for chunk in [0, chunks); worker is in [0, size())
+        void run(int chunks, function<void(int, int)> task, function<void()> tick = nullptr, int tick_ms = 50);
+
+        void setTotal(long n) { total = n; done = 0; }
+        void addDone(long n = 1) { done.fetch_add(n, memory_order_relaxed); }
+        int percentDone() const;
+
+        void cancel() { cancelled_flag = true; }
+        bool cancelled() const { return cancelled_flag.load(memory_order_relaxed); }
+        void reset() { cancelled_flag = false; }
+
+    private:
+        vector<thread> workers;
+        mutex m;
+        mutex run_mutex;                // one run() at a time
+        condition_variable wake;        // a new job, or quitting
+        condition_variable finished;    // all workers are done with the job
+        unsigned long generation;       // counts jobs
+        int active;                     // workers still on the current job
+        bool quit;
+
+        function<void(int, int)> job;
+        int job_chunks;
+        atomic<int> next_chunk;
+
+        atomic<long> total;
+        atomic<long> done;
+        atomic<bool> cancelled_flag;
+
+        void work(int w);
+};
+
+#endif
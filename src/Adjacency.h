@@ -0,0 +1,67 @@
+#ifndef ADJACENCY_H
+#define ADJACENCY_H
+
+#include <vector>
+#include <unordered_map>
+#include "Network.h"
+
+using namespace std;
+
+/******************************************************************************
+ * A compact, read-only copy of a network's topology.  Nodes are referred to by
+ * their index in net->get_nodes(), and the neighbors of node i are stored
+ * contiguously in neighbors[ offsets[i] ] ... neighbors[ offsets[i+1] - 1 ].
+ *
+ * This is meant for code that needs to walk the same topology many times (or
+ * from many threads at once) without touching Node/Edge objects:
+ *
+ *      Adjacency adj(&my_network);
+ *      for (int i = 0; i < adj.size(); i++) {
+ *          for (int e = adj.begin(i); e < adj.end(i); e++) {
+ *              int neighbor = adj.neighbors[e];
+ *          }
+ *      }
+ *
+ * The snapshot is not updated if the network is modified afterward.
+ *****************************************************************************/
+
+class Adjacency {
+    public:
+        vector<int> offsets;     // size() + 1 entries
+        vector<int> neighbors;   // end of each outbound edge, as a node index
+        vector<double> costs;    // edge costs, parallel to neighbors
+        vector<Node*> nodes;     // index -> Node*
+
+        Adjacency() {}
+        Adjacency(Network* net) { build(net); }
+
+        void build(Network* net) {
+            nodes = net->get_nodes();
+            const int n = nodes.size();
+
+            unordered_map<const Node*, int> index;
+            index.reserve(n);
+            for (int i = 0; i < n; i++) index[nodes[i]] = i;
+
+            offsets.assign(n + 1, 0);
+            for (int i = 0; i < n; i++) offsets[i+1] = offsets[i] + nodes[i]->deg();
+
+            neighbors.resize(offsets[n]);
+            costs.resize(offsets[n]);
+            for (int i = 0; i < n; i++) {
+                vector<Edge*> edges = nodes[i]->get_edges_out();
+                for (unsigned int e = 0; e < edges.size(); e++) {
+                    neighbors[ offsets[i] + e ] = index[ edges[e]->get_end() ];
+                    costs[ offsets[i] + e ]     = edges[e]->get_cost();
+                }
+            }
+        }
+
+        inline int size() const { return offsets.size() - 1; }
+        inline int begin(int i) const { return offsets[i]; }
+        inline int end(int i) const { return offsets[i+1]; }
+        inline int deg(int i) const { return offsets[i+1] - offsets[i]; }
+        inline int num_edges() const { return neighbors.size(); }
+};
+
+#endif
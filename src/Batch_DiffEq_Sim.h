@@ -0,0 +1,265 @@
+#ifndef BATCH_DIFFEQ_SIM_H
+#define BATCH_DIFFEQ_SIM_H
+
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include "Utility.h"
+#include "SIR_Sim.h"
+#include "Deterministic_Network_SIR_Sim.h"
+
+using namespace std;
+
+/******************************************************************************
+ * Integrates the same model for many parameter sets at once, e.g. to evaluate
+ * a fitting objective over a grid:
+ *
+ *      Batch_DiffEq_Sim<SIR> batch;
+ *      // params holds beta, gamma for each set; y0 holds S, I, R for each set
+ *      batch.run(params, y0, days);
+ *      double I_on_day_10 = batch.get(set, 10, 1);
+ *
+ * Sets are integrated W at a time (a "batch"), with every variable stored as a
+ * W-wide array (y[i*W + lane]), so that each stage of the RKF45 step is a set
+ * of short loops over lanes that the compiler can vectorize, and the model's
+ * derivative is inlined rather than called virtually.  Each lane has its own
+ * time and step size; error control is the same as GSL's y_new control (and so
+ * DiffEq_Sim's), applied per lane, so a lane that rejects its step simply
+ * retries with a smaller one while the others carry on.  Batches are shared
+ * out among threads.
+ *
+ * Models are supported through a specialization of Batch_Kernel, which gives
+ * the number of variables and parameters and a derivative over W lanes.
+ * Kernels for SIR and Deterministic_Network_SIR_Sim are below.
+ *****************************************************************************/
+
+template <class Sim> class Batch_Kernel;
+
+template <> class Batch_Kernel<SIR> {
+    public:
+        enum { nbins = 3, nparams = 2 }; // S, I, R; beta, gamma
+
+        template <int W>
+        inline void derivative(const double* p, const double* y, double* dydt) const {
+            const double* beta = p;     const double* gamma = p + W;
+            const double* S = y;        const double* I = y + W;
+            for (int l = 0; l < W; l++) {
+                const double infection = beta[l] * S[l] * I[l];
+                const double recovery  = gamma[l] * I[l];
+                dydt[l]       = -infection;
+                dydt[W + l]   = infection - recovery;
+                dydt[2*W + l] = recovery;
+            }
+        }
+};
+
+template <> class Batch_Kernel<Deterministic_Network_SIR_Sim> {
+    public:
+        enum { nbins = 4, nparams = 2 }; // theta, pS, pI, I; r, mu
+
+        // The degree distribution is shared by every parameter set.  Its tail is
+        // dropped just as Deterministic_Network_SIR_Sim drops it, for the same
+        // tail_tol, so the two integrate the same equations.
+        Batch_Kernel(const vector<double>& deg_dist, double tail_tol = 1e-12) {
+            const int kmax = Deterministic_Network_SIR_Sim(0.0, 0.0, deg_dist, tail_tol).get_truncated_max_deg();
+            // coefficients of g'(theta) and g''(theta), for Horner's rule
+            for (int i = 1; i <= kmax; i++) dg_coef.push_back(i * deg_dist[i]);
+            for (int i = 2; i <= kmax; i++) ddg_coef.push_back((double) i * (i-1) * deg_dist[i]);
+        }
+
+        template <int W>
+        inline void derivative(const double* p, const double* y, double* dydt) const {
+            const double* r = p;        const double* mu = p + W;
+            const double* theta = y;    const double* pS = y + W;
+            const double* pI = y + 2*W; const double* I = y + 3*W;
+
+            double dg[W], ddg[W];
+            for (int l = 0; l < W; l++) { dg[l] = 0; ddg[l] = 0; }
+            for (int k = (int) dg_coef.size() - 1; k >= 0; k--) {
+                for (int l = 0; l < W; l++) dg[l] = dg[l] * theta[l] + dg_coef[k];
+            }
+            for (int k = (int) ddg_coef.size() - 1; k >= 0; k--) {
+                for (int l = 0; l < W; l++) ddg[l] = ddg[l] * theta[l] + ddg_coef[k];
+            }
+
+            for (int l = 0; l < W; l++) {
+                const double ratio = theta[l] * ddg[l] / dg[l];
+                dydt[l]       = -r[l] * pI[l] * theta[l];
+                dydt[W + l]   = r[l] * pS[l] * pI[l] * (1 - ratio);
+                dydt[2*W + l] = r[l] * pI[l] * pS[l] * ratio - pI[l] * (1 - pI[l]) * r[l] - pI[l] * mu[l];
+                dydt[3*W + l] = r[l] * pI[l] * theta[l] * dg[l] - mu[l] * I[l];
+            }
+        }
+
+    private:
+        vector<double> dg_coef;
+        vector<double> ddg_coef;
+};
+
+
+template <class Sim, int W = 8>
+class Batch_DiffEq_Sim {
+    public:
+        typedef Batch_Kernel<Sim> Kernel;
+        enum { nbins = Kernel::nbins, nparams = Kernel::nparams };
+
+        Batch_DiffEq_Sim(Kernel k = Kernel(), int num_threads = 0) : kernel(k) {
+            threads = num_threads > 0 ? num_threads : MAX(1, (int) thread::hardware_concurrency());
+            eps_abs = 1e-5;     // same as DiffEq_Sim::step_simulation
+            eps_rel = 0;
+            num_sets = 0;
+        }
+
+        void set_tolerances(double abs, double rel) { eps_abs = abs; eps_rel = rel; }
+        void set_num_threads(int n) { threads = MAX(1, n); }
+
+        // params: nparams values for each set, one set after another
+        // y0:     initial values (nbins per set), in the same order
+        // times:  increasing output times (> 0); integration starts at 0
+        void run(const vector<double>& params, const vector<double>& y0, const vector<double>& times) {
+            num_sets = params.size() / nparams;
+            assert(params.size() == (size_t) num_sets * nparams);
+            assert(y0.size() == (size_t) num_sets * nbins);
+            output_times = times;
+            results.assign((size_t) num_sets * times.size() * nbins, 0.0);
+            if (num_sets == 0 or times.size() == 0) return;
+
+            const int num_batches = (num_sets + W - 1) / W;
+            atomic<int> next_batch(0);
+            vector<thread> pool;
+            const int n = MIN(threads, num_batches);
+            for (int i = 0; i < n; i++) {
+                pool.push_back( thread([&]() {
+                    int b;
+                    while ((b = next_batch++) < num_batches) integrate_batch(b, params, y0);
+                }) );
+            }
+            for (unsigned int i = 0; i < pool.size(); i++) pool[i].join();
+        }
+
+        int size() { return num_sets; }
+
+        // variable i of parameter set s at output_times[j]
+        double get(int s, int j, int i) const { return results[((size_t) s * output_times.size() + j) * nbins + i]; }
+
+        vector<double> get_state(int s, int j) const {
+            const double* r = &results[((size_t) s * output_times.size() + j) * nbins];
+            return vector<double>(r, r + nbins);
+        }
+
+    private:
+        Kernel kernel;
+        int threads;
+        double eps_abs;
+        double eps_rel;
+        int num_sets;
+        vector<double> output_times;
+        vector<double> results;
+
+        void integrate_batch(int b, const vector<double>& params, const vector<double>& y0) {
+            // RKF45 coefficients, as in gsl_subset/ode-initval/rkf45.c
+            static const double ah[] = { 1.0/4.0, 3.0/8.0, 12.0/13.0, 1.0, 1.0/2.0 };
+            static const double b3[] = { 3.0/32.0, 9.0/32.0 };
+            static const double b4[] = { 1932.0/2197.0, -7200.0/2197.0, 7296.0/2197.0 };
+            static const double b5[] = { 8341.0/4104.0, -32832.0/4104.0, 29440.0/4104.0, -845.0/4104.0 };
+            static const double b6[] = { -6080.0/20520.0, 41040.0/20520.0, -28352.0/20520.0, 9295.0/20520.0, -5643.0/20520.0 };
+            static const double c1 = 902880.0/7618050.0;
+            static const double c3 = 3953664.0/7618050.0;
+            static const double c4 = 3855735.0/7618050.0;
+            static const double c5 = -1371249.0/7618050.0;
+            static const double c6 = 277020.0/7618050.0;
+            static const double ec[] = { 0.0, 1.0/360.0, 0.0, -128.0/4275.0, -2197.0/75240.0, 1.0/50.0, 2.0/55.0 };
+
+            const int D = nbins * W;
+            double p[nparams * W];
+            double y[D], ytmp[D], yout[D], yerr[D];
+            double k1[D], k2[D], k3[D], k4[D], k5[D], k6[D];
+            double t[W], h[W], hs[W];
+            int next_out[W];
+            const int num_out = output_times.size();
+
+            // lanes past the last set repeat it, and their results are dropped
+            for (int l = 0; l < W; l++) {
+                const int s = MIN(b * W + l, num_sets - 1);
+                for (int j = 0; j < nparams; j++) p[j*W + l] = params[(size_t) s * nparams + j];
+                for (int i = 0; i < nbins; i++) y[i*W + l] = y0[(size_t) s * nbins + i];
+                t[l] = 0.0;
+                h[l] = 0.1;     // DiffEq_Sim's initial step
+                next_out[l] = 0;
+            }
+
+            int active = W;
+            while (active > 0) {
+                for (int l = 0; l < W; l++) {
+                    hs[l] = next_out[l] < num_out ? MIN(h[l], output_times[ next_out[l] ] - t[l]) : 0.0;
+                }
+
+                kernel.template derivative<W>(p, y, k1);
+                for (int i = 0; i < nbins; i++) for (int l = 0; l < W; l++) {
+                    const int x = i*W + l;
+                    ytmp[x] = y[x] + hs[l] * ah[0] * k1[x];
+                }
+                kernel.template derivative<W>(p, ytmp, k2);
+                for (int i = 0; i < nbins; i++) for (int l = 0; l < W; l++) {
+                    const int x = i*W + l;
+                    ytmp[x] = y[x] + hs[l] * (b3[0]*k1[x] + b3[1]*k2[x]);
+                }
+                kernel.template derivative<W>(p, ytmp, k3);
+                for (int i = 0; i < nbins; i++) for (int l = 0; l < W; l++) {
+                    const int x = i*W + l;
+                    ytmp[x] = y[x] + hs[l] * (b4[0]*k1[x] + b4[1]*k2[x] + b4[2]*k3[x]);
+                }
+                kernel.template derivative<W>(p, ytmp, k4);
+                for (int i = 0; i < nbins; i++) for (int l = 0; l < W; l++) {
+                    const int x = i*W + l;
+                    ytmp[x] = y[x] + hs[l] * (b5[0]*k1[x] + b5[1]*k2[x] + b5[2]*k3[x] + b5[3]*k4[x]);
+                }
+                kernel.template derivative<W>(p, ytmp, k5);
+                for (int i = 0; i < nbins; i++) for (int l = 0; l < W; l++) {
+                    const int x = i*W + l;
+                    ytmp[x] = y[x] + hs[l] * (b6[0]*k1[x] + b6[1]*k2[x] + b6[2]*k3[x] + b6[3]*k4[x] + b6[4]*k5[x]);
+                }
+                kernel.template derivative<W>(p, ytmp, k6);
+                for (int i = 0; i < nbins; i++) for (int l = 0; l < W; l++) {
+                    const int x = i*W + l;
+                    yout[x] = y[x] + hs[l] * (c1*k1[x] + c3*k3[x] + c4*k4[x] + c5*k5[x] + c6*k6[x]);
+                    yerr[x] = hs[l] * (ec[1]*k1[x] + ec[3]*k3[x] + ec[4]*k4[x] + ec[5]*k5[x] + ec[6]*k6[x]);
+                }
+
+                // per-lane step control, as in gsl_subset/ode-initval/cstd.c
+                for (int l = 0; l < W; l++) {
+                    if (next_out[l] == num_out) continue;
+                    double rmax = 0;
+                    for (int i = 0; i < nbins; i++) {
+                        const double D0 = eps_rel * fabs(yout[i*W + l]) + eps_abs;
+                        rmax = MAX(rmax, fabs(yerr[i*W + l]) / D0);
+                    }
+                    if (rmax > 1.1) {                       // reject, and retry with a smaller step
+                        h[l] = hs[l] * MAX(0.9 / pow(rmax, 1.0/5.0), 0.2);
+                        continue;
+                    }
+                    for (int i = 0; i < nbins; i++) y[i*W + l] = yout[i*W + l];
+                    if (rmax < 0.5) {
+                        const double r = MIN(MAX(0.9 / pow(rmax, 1.0/6.0), 1.0), 5.0);
+                        h[l] = MAX(h[l], hs[l] * r);
+                    }
+                    if (hs[l] == output_times[ next_out[l] ] - t[l]) { // reached an output time
+                        t[l] = output_times[ next_out[l] ];
+                        const int s = b * W + l;
+                        if (s < num_sets) {
+                            for (int i = 0; i < nbins; i++) {
+                                results[((size_t) s * num_out + next_out[l]) * nbins + i] = y[i*W + l];
+                            }
+                        }
+                        if (++next_out[l] == num_out) active--;
+                    } else {
+                        t[l] += hs[l];
+                    }
+                }
+            }
+        }
+};
+
+#endif
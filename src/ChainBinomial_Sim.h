@@ -2,45 +2,76 @@
 #define  CHAIN_SIMULATOR_H
 
 #include "Simulator.h"
-#include <queue>
-
-class Event {
 
+// The day on which an infectious node first transmits to a susceptible
+// neighbor is geometric with parameter T, truncated at the infectious period.
+// Both delay samplers below work by inversion, so each draw costs one uniform
+// deviate and one log, no matter how long the infectious period is.
+class Transmission_Delay {
     public:
-        Node* sink_node;
-        int time;
-        Node* source_node;
-        Event(const Event& o) {  sink_node=o.sink_node; time = o.time; source_node = o.source_node; }
-        Event(Node* sink, int t, Node* source) {  sink_node=sink; time=t; source_node=source; }
-        Event& operator=(const Event& o) {
-            if (this != &o) {
-                sink_node=o.sink_node; time = o.time; source_node = o.source_node;
-            }
-            return *this;
+        double T;
+        int infectious_period;
+        double T_overall;        // P{transmission on some day of the infectious period}
+
+        Transmission_Delay() { set(0.0, 1); }
+        Transmission_Delay(double T, int infectious_period) { set(T, infectious_period); }
+
+        void set(double T, int infectious_period) {
+            this->T = T;
+            this->infectious_period = infectious_period;
+            T_overall = 1.0 - pow(1.0 - T, infectious_period);
+            log_q   = log(1.0 - T);                   // -inf if T == 1
+            log_miss = infectious_period * log_q;     // log(1 - T_overall)
         }
 
-};
+        // Day of transmission (1 ... infectious_period), or 0 if it doesn't happen
+        int rand_delay(mt19937* rng) const {
+            if (T <= 0.0) return 0;
+            if (T >= 1.0) return 1;
+            double d = 1.0 + floor( log(1.0 - rand_uniform(0, 1, rng)) / log_q );
+            return d > infectious_period ? 0 : (int) d;
+        }
 
-class compTime {
-    public:
-        bool operator() (const Event* lhs, const Event* rhs) const {
-            return (lhs->time>rhs->time);
+        // Day of transmission, given that transmission happens
+        int rand_conditional_delay(mt19937* rng) const {
+            if (T >= 1.0) return 1;
+            int d = 1 + (int) ( log(1.0 - rand_uniform(0, 1, rng) * T_overall) / log_q );
+            return MIN(d, infectious_period); // guard against rounding at the upper end
         }
 
-        bool operator() (const Event& lhs, const Event& rhs) const {
-            return (lhs.time>rhs.time);
+        // Number of susceptible neighbors that escape infection before the next one
+        // that doesn't, i.e. the number of failures before the next success in
+        // Bernoulli(T_overall) trials
+        int rand_skip(mt19937* rng) const {
+            if (T <= 0.0) return numeric_limits<int>::max();
+            if (T >= 1.0) return 0;
+            double skip = floor( log(1.0 - rand_uniform(0, 1, rng)) / log_miss );
+            return skip < numeric_limits<int>::max() ? (int) skip : numeric_limits<int>::max();
         }
+
+    private:
+        double log_q;
+        double log_miss;
 };
 
 
 class ChainBinomial_Sim: public Simulator
 {
     protected:
-        list<Node*> infected;
+        // Transmission times are always between 1 and infectious_period days in the
+        // future, so pending transmissions are kept in a calendar: a ring buffer of
+        // (at least) infectious_period+1 buckets, one per day, holding the nodes to be
+        // infected.  Infected nodes are kept in a ring of infectious_period daily
+        // cohorts, so the nodes that recover each day are exactly the cohort infected
+        // that many days ago.  If the infectious period changes mid-epidemic, both are
+        // rebuilt (see _rebuild_calendars()).
+        vector< vector<Node*> > transmission_calendar;
+        vector< vector<Node*> > infected_cohorts;
+        int infected_ct;
         vector<Node*> recovered;
         vector<double> time_dist; // Probability mass function for day of transmission
+        Transmission_Delay delay; // Samples from time_dist
         bool update_time_dist;
-        priority_queue<Event, vector<Event>, compTime > transmissionQ;
         
         vector< int > epi_curve;  // new infections at each time step (incidence)
         vector< pair<int, Node*> > detailed_epi_curve; // track node->infected node state changes as (time, node_id) pairs
@@ -49,8 +80,8 @@ class ChainBinomial_Sim: public Simulator
         double T;                // transmissibiltiy per time step
         int infectious_period;
 
-        ChainBinomial_Sim():Simulator() { this->time = 0; this->update_time_dist=true;};
-        ChainBinomial_Sim(Network* net, int infectious_period, double T):Simulator(net) { this->infectious_period=infectious_period; this->T=T; define_time_dist();};
+        ChainBinomial_Sim():Simulator() { this->time = 0; this->infected_ct = 0; this->update_time_dist=true;};
+        ChainBinomial_Sim(Network* net, int infectious_period, double T):Simulator(net) { this->infectious_period=infectious_period; this->T=T; this->infected_ct = 0; define_time_dist();};
 
         void set_network(Network* net) { this->net=net; }
         void set_infectious_period(int d) { this->infectious_period = d; this->update_time_dist=true;}
@@ -68,7 +99,9 @@ class ChainBinomial_Sim: public Simulator
                 time_dist.push_back( pow(1-T, i) * T );
             }
             time_dist.push_back( pow(1-T, infectious_period) );
+            delay.set(T, infectious_period);
             this->update_time_dist = false;
+            if ((int) infected_cohorts.size() != infectious_period) _rebuild_calendars();
             return time_dist;
         }
 
@@ -84,57 +117,61 @@ class ChainBinomial_Sim: public Simulator
 
         void infect_node(Node* node) {
             if (node->get_state() != 0) return; //already infected or recovered
+            if (update_time_dist == true) define_time_dist();
             node->set_state(1);
-            infected.push_back(node);
+            infected_cohorts[time % infectious_period].push_back(node);
+            infected_ct++;
             epi_curve.resize(time+1, 0);
             epi_curve[time]++;
             detailed_epi_curve.push_back( make_pair(time, node) );
 
+            // Rather than drawing a transmission day for every susceptible neighbor,
+            // skip directly to the ones that will be infected (each is, independently,
+            // with probability T_overall), and only draw transmission days for those.
+            // This matters for hubs, since most of their neighbors usually escape.
             vector<Node*> neighbors = node->get_neighbors();
+            INSTRUMENT_COUNT("edges examined", neighbors.size());
+            int skip = delay.rand_skip(rng);
             for (unsigned int i = 0; i<neighbors.size(); i++) {
-                if (neighbors[i]->get_state() == 0) {
-                    int t = rand_nonuniform_int(time_dist, rng) + 1;
-                    if (t > infectious_period) {
-                        continue;
-                    } else {
-                        transmissionQ.push( Event( neighbors[i], time + t, node ) );
-                    }
-                }
+                if (neighbors[i]->get_state() != 0) continue;
+                if (skip-- > 0) continue;
+                int t = delay.rand_conditional_delay(rng);
+                transmission_calendar[(time + t) % transmission_calendar.size()].push_back( neighbors[i] );
+                skip = delay.rand_skip(rng);
             }
         }
 
         void step_simulation () {
+            INSTRUMENT_SPAN("ChainBinomial_Sim::step_simulation");
             if (update_time_dist == true) define_time_dist();
             // States: 0 (default) is susceptible
             //         1 is infectious day 1
             //         2 is infectious day 2
             //         ... up to the infectious period
             //         -1 is recovered
-            int inf_size = infected.size();
-            assert(inf_size > 0);
+            assert(infected_ct > 0);
             time++;
-            list<Node*>::iterator inode;
-            for (inode=infected.begin(); inode!=infected.end(); inode++) {
-                // Increment node states through the infectious period
-                (*inode)->set_state( (*inode)->get_state()+1 );
-            }
-
-            // Some nodes may be reaching the end of their infectious period ...
-
-            while (inf_size-- > 0) {
-                Node* first = infected.front();
-                if (first->get_state() <= infectious_period) break;
 
-                first->set_state(-1); // -> recovered
-                recovered.push_back( first );
-                infected.pop_front();
+            // Nodes infected infectious_period days ago recover today ...
+            vector<Node*>& recovering = infected_cohorts[time % infectious_period];
+            for (unsigned int i = 0; i < recovering.size(); i++) {
+                recovering[i]->set_state(-1); // -> recovered
+                recovered.push_back( recovering[i] );
             }
+            infected_ct -= recovering.size();
+            recovering.clear();
 
-            while (not transmissionQ.empty() and transmissionQ.top().time <= time) {
-                Event event = transmissionQ.top();
-                transmissionQ.pop();
-                infect_node( event.sink_node );
+            // ... and everyone else moves to the next day of their infectious period
+            for (unsigned int c = 0; c < infected_cohorts.size(); c++) {
+                vector<Node*>& cohort = infected_cohorts[c];
+                for (unsigned int i = 0; i < cohort.size(); i++) cohort[i]->set_state( cohort[i]->get_state()+1 );
             }
+
+            // infect_node() only schedules transmissions on later days, so today's
+            // bucket doesn't change while we work through it
+            vector<Node*>& today = transmission_calendar[time % transmission_calendar.size()];
+            for (unsigned int i = 0; i < today.size(); i++) infect_node( today[i] );
+            today.clear();
         }
 
         void run_simulation() {
@@ -142,17 +179,55 @@ class ChainBinomial_Sim: public Simulator
             if (update_time_dist == true) define_time_dist();
             
             // As long as someone's still infected, step simulation
-            while (infected.size() > 0)  step_simulation();
+            while (infected_ct > 0)  step_simulation();
         }
 
-        void add_event( Node* sink_node, int time, Node* source_node) {
-            transmissionQ.push( Event(sink_node,time,source_node) );
+        // Schedule an infection of sink_node.  Times in the past are treated as
+        // tomorrow, and times more than infectious_period days out are not allowed.
+        void add_event( Node* sink_node, int time, Node* /*source_node*/) {
+            if (update_time_dist == true) define_time_dist();
+            assert(time - this->time <= infectious_period);
+            time = MAX(time, this->time + 1);
+            transmission_calendar[time % transmission_calendar.size()].push_back( sink_node );
             return;
         }
 
+    protected:
+        // Re-bucket the calendars for a new infectious period, keeping everything in
+        // them.  Infected nodes keep their day of infection, so they recover
+        // infectious_period days after it, or tomorrow if that day has passed.
+        // Pending transmissions keep their days, and the transmission ring grows if
+        // some are further out than the new period allows for.
+        void _rebuild_calendars() {
+            const int old_period = infected_cohorts.size();
+            vector< vector<Node*> > cohorts(infectious_period);
+            for (int c = 0; c < old_period; c++) {
+                const int infected_on = time - (((time - c) % old_period) + old_period) % old_period;
+                const int recovery_day = MAX(infected_on + infectious_period, time + 1);
+                vector<Node*>& dest = cohorts[recovery_day % infectious_period];
+                dest.insert(dest.end(), infected_cohorts[c].begin(), infected_cohorts[c].end());
+            }
+            infected_cohorts.swap(cohorts);
+
+            const int old_days = transmission_calendar.size();
+            int furthest = 0;
+            for (int d = 0; d < old_days; d++) {
+                if (transmission_calendar[d].size() > 0) furthest = MAX(furthest, (((d - time) % old_days) + old_days) % old_days);
+            }
+            vector< vector<Node*> > calendar(MAX(infectious_period, furthest) + 1);
+            for (int d = 0; d < old_days; d++) {
+                const int day = time + (((d - time) % old_days) + old_days) % old_days;
+                vector<Node*>& dest = calendar[day % calendar.size()];
+                dest.insert(dest.end(), transmission_calendar[d].begin(), transmission_calendar[d].end());
+            }
+            transmission_calendar.swap(calendar);
+        }
+
+    public:
+
 
         int count_infected() {
-            return infected.size();
+            return infected_ct;
         }
 
         int epidemic_size() {
@@ -182,10 +257,13 @@ class ChainBinomial_Sim: public Simulator
         void reset() {
             reset_time();
 
-            while (! infected.empty()) {
-                infected.front()->set_state(0);
-                infected.pop_front();
+            for (unsigned int c = 0; c < infected_cohorts.size(); c++) {
+                set_these_nodes_to_state(infected_cohorts[c], 0);
+                infected_cohorts[c].clear();
             }
+            infected_ct = 0;
+
+            for (unsigned int d = 0; d < transmission_calendar.size(); d++) transmission_calendar[d].clear();
 
             set_these_nodes_to_state(recovered, 0);
             recovered.clear();
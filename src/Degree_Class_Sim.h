@@ -0,0 +1,187 @@
+#ifndef DEGREE_CLASS_SIM_H
+#define DEGREE_CLASS_SIM_H
+
+#include <gsl/gsl_odeiv.h>
+#include <gsl/gsl_errno.h>
+#include <iostream>
+#include <math.h>
+#include "Utility.h"
+#include "DiffEq_Sim.h"
+
+using namespace std;
+
+/******************************************************************************
+ * Heterogeneous mean-field (degree-class) epidemic equations for an
+ * uncorrelated network with a given degree distribution.  Nodes with the same
+ * degree k are treated as one class, with its own fraction susceptible,
+ * exposed, infectious and recovered:
+ *
+ *      dS_k/dt = -beta k S_k Theta                       (+ gamma I_k for SIS)
+ *      dE_k/dt =  beta k S_k Theta - sigma E_k           (SEIR only)
+ *      dI_k/dt =  beta k S_k Theta - gamma I_k           (sigma E_k for SEIR)
+ *      dR_k/dt =  gamma I_k                              (SIR and SEIR)
+ *
+ * where beta is the transmission rate per edge and Theta is the chance that an
+ * edge leads to an infectious node.  For SIS, Theta = sum_k k P(k) I_k / <k>;
+ * for SIR and SEIR, an infected node can't infect back along the edge it was
+ * infected by, so Theta = sum_k (k-1) P(k) I_k / <k>.
+ *
+ * Only degrees with P(k) > 0 get a class.  Theta is one pass over the classes,
+ * and the rest of the derivative is a second, element-wise pass, so each
+ * evaluation is O(number of classes).  Nothing depends on network size, so
+ * the degree distribution can come from Network::get_deg_dist(), or describe a
+ * population far too large to build.
+ *
+ * y is laid out by compartment: S for every class, then E (SEIR only), I, and
+ * R (not for SIS).
+ *****************************************************************************/
+
+class Degree_Class_Sim : public DiffEq_Sim {
+    public:
+        typedef enum {
+            SIR_MODEL, SEIR_MODEL, SIS_MODEL
+        } modelType;
+
+        Degree_Class_Sim(modelType m, const vector<double>& deg_dist, double b, double g, double s = 0.0) {
+            model = m;
+            set_parameters(b, g, s);
+            set_deg_dist(deg_dist);
+        }
+
+        // counts of nodes by degree, as from Network::get_deg_dist()
+        Degree_Class_Sim(modelType m, const vector<int>& deg_counts, double b, double g, double s = 0.0) {
+            model = m;
+            set_parameters(b, g, s);
+            set_deg_dist( vector<double>(deg_counts.begin(), deg_counts.end()) );
+        }
+
+        ~Degree_Class_Sim() {};
+
+        // for reusing one instance across parameter values; follow with initialize()
+        void set_parameters(double b, double g, double s = 0.0) {
+            beta = b;
+            gamma = g;
+            sigma = s;
+        }
+
+        // (not necessarily normalized); also follow with initialize()
+        void set_deg_dist(const vector<double>& deg_dist) {
+            degree.clear();
+            weight.clear();
+            double total = 0, mean_deg = 0;
+            for (unsigned int k = 0; k < deg_dist.size(); k++) {
+                total += deg_dist[k];
+                mean_deg += k * deg_dist[k];
+            }
+            for (unsigned int k = 0; k < deg_dist.size(); k++) {
+                if (deg_dist[k] <= 0) continue;
+                degree.push_back(k);
+                weight.push_back(deg_dist[k] / total);
+            }
+            mean_deg /= total;
+            degree_d.assign(degree.begin(), degree.end());
+
+            const int n = degree.size();
+            edge_weight.resize(n);
+            for (int j = 0; j < n; j++) {
+                const double excess = model == SIS_MODEL ? degree[j] : degree[j] - 1.0;
+                edge_weight[j] = mean_deg > 0 ? MAX(excess, 0.0) * weight[j] / mean_deg : 0.0;
+            }
+
+            compartments = model == SEIR_MODEL ? 4 : model == SIR_MODEL ? 3 : 2;
+            nbins = compartments * n;
+        }
+
+        // the same fraction of every class starts out infectious (or exposed, for SEIR)
+        void initialize(double infected) {
+            init_state();
+            const int n = num_classes();
+            for (int j = 0; j < n; j++) {
+                S()[j] = 1.0 - infected;
+                if (model == SEIR_MODEL) E()[j] = infected;
+                else I()[j] = infected;
+            }
+        }
+
+        int num_classes() { return degree.size(); }
+        int class_degree(int j) { return degree[j]; }
+
+        // fraction of class j that is in each state
+        double susceptible(int j) { return S()[j]; }
+        double exposed(int j)     { return model == SEIR_MODEL ? E()[j] : 0.0; }
+        double infectious(int j)  { return I()[j]; }
+        double recovered(int j)   { return model == SIS_MODEL ? 0.0 : R()[j]; }
+
+        // fraction of the whole population in each state
+        double current_susceptible() { return average(S()); }
+        double current_exposed()     { return model == SEIR_MODEL ? average(E()) : 0.0; }
+        double current_infectious()  { return average(I()); }
+        double current_recovered()   { return model == SIS_MODEL ? 0.0 : average(R()); }
+
+        void derivative(double const y[], double dydt[]) {
+            const int n = degree.size();
+            const double* S = y;
+            const double* E = y + n;
+            const double* I = model == SEIR_MODEL ? y + 2*n : y + n;
+            double* dS = dydt;
+            double* dE = dydt + n;
+            double* dI = model == SEIR_MODEL ? dydt + 2*n : dydt + n;
+            double* dR = dI + n;
+
+            double theta = 0.0;
+            for (int j = 0; j < n; j++) theta += edge_weight[j] * I[j];
+            const double force = beta * theta;
+
+            const double* k = degree_d.data();
+            if (model == SIR_MODEL) {
+                for (int j = 0; j < n; j++) {
+                    const double infection = force * k[j] * S[j];
+                    const double recovery  = gamma * I[j];
+                    dS[j] = -infection;
+                    dI[j] = infection - recovery;
+                    dR[j] = recovery;
+                }
+            } else if (model == SEIR_MODEL) {
+                for (int j = 0; j < n; j++) {
+                    const double infection = force * k[j] * S[j];
+                    const double onset     = sigma * E[j];
+                    const double recovery  = gamma * I[j];
+                    dS[j] = -infection;
+                    dE[j] = infection - onset;
+                    dI[j] = onset - recovery;
+                    dR[j] = recovery;
+                }
+            } else {
+                for (int j = 0; j < n; j++) {
+                    const double infection = force * k[j] * S[j];
+                    const double recovery  = gamma * I[j];
+                    dS[j] = recovery - infection;
+                    dI[j] = infection - recovery;
+                }
+            }
+        }
+
+    private:
+        modelType model;
+        double beta;                // transmission rate per edge
+        double gamma;               // recovery rate
+        double sigma;               // rate of becoming infectious (SEIR)
+        int compartments;
+        vector<int> degree;         // degree of each class
+        vector<double> degree_d;    // same, as doubles, for the derivative loops
+        vector<double> weight;      // P(k) for each class
+        vector<double> edge_weight; // contribution of each class's I_k to Theta
+
+        double* S() { return y; }
+        double* E() { return y + degree.size(); }
+        double* I() { return model == SEIR_MODEL ? y + 2*degree.size() : y + degree.size(); }
+        double* R() { return I() + degree.size(); }
+
+        double average(const double* x) {
+            double val = 0;
+            for (unsigned int j = 0; j < degree.size(); j++) val += weight[j] * x[j];
+            return val;
+        }
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <gsl/gsl_errno.h>
 #include <iostream>
 #include <math.h>
+#include "Utility.h"
 #include "DiffEq_Sim.h"
 
 using namespace std;
@@ -12,22 +13,96 @@ using namespace std;
 class Deterministic_Network_SIR_Sim : public DiffEq_Sim {
 
     private:
-        const double r;
-        const double mu;
-        const vector<double> deg_dist;
+        double r;
+        double mu;
+        vector<double> deg_dist;
+
+        // g, g' and g'' are evaluated together, from coefficient arrays that are
+        // built once per degree distribution:
+        //     g(theta)   = sum_j  g_coef[j] * theta^j,  g_coef[j]   = p_j
+        //     g'(theta)  = sum_j dg_coef[j] * theta^j,  dg_coef[j]  = (j+1) p_{j+1}
+        //     g''(theta) = sum_j ddg_coef[j] * theta^j, ddg_coef[j] = (j+2)(j+1) p_{j+2}
+        // The arrays are padded with zeros to a multiple of PGF_LANES, so that
+        // the powers of theta and the three sums can be done PGF_LANES terms at
+        // a time, in loops the compiler can vectorize.
+        static const int PGF_LANES = 8;
+        vector<double> g_coef;
+        vector<double> dg_coef;
+        vector<double> ddg_coef;
+        vector<double> block_tail;  // total coefficient size from each block of PGF_LANES on
+        int truncated_max_deg;
+        double tail_tolerance;
+        double truncation_error;
+
+        // Drop the tail of the degree distribution that contributes less than
+        // tail_tolerance (relatively) to each of g(1), g'(1) and g''(1).  For
+        // 0 <= theta <= 1, that changes g, g' and g'' by at most the dropped
+        // sums, the largest of which is kept as truncation_error.
+        void prepare_pgf() {
+            double total[3] = {0, 0, 0};
+            for (unsigned int k = 0; k < deg_dist.size(); k++) {
+                total[0] += deg_dist[k];
+                total[1] += k * deg_dist[k];
+                total[2] += k * (k - 1.0) * deg_dist[k];
+            }
+            double tail[3] = {0, 0, 0};
+            int kmax = (int) deg_dist.size() - 1;
+            while (kmax > 0) {
+                const double p = deg_dist[kmax];
+                if (tail[0] + p > tail_tolerance * total[0] or
+                    tail[1] + kmax * p > tail_tolerance * total[1] or
+                    tail[2] + kmax * (kmax - 1.0) * p > tail_tolerance * total[2]) break;
+                tail[0] += p;
+                tail[1] += kmax * p;
+                tail[2] += kmax * (kmax - 1.0) * p;
+                kmax--;
+            }
+            truncation_error = MAX(tail[0], MAX(tail[1], tail[2]));
+
+            const int n = ((kmax + 1 + PGF_LANES - 1) / PGF_LANES) * PGF_LANES;
+            g_coef.assign(n, 0.0);
+            dg_coef.assign(n, 0.0);
+            ddg_coef.assign(n, 0.0);
+            for (int j = 0; j <= kmax; j++) {
+                g_coef[j] = deg_dist[j];
+                if (j + 1 <= kmax) dg_coef[j]  = (j + 1.0) * deg_dist[j + 1];
+                if (j + 2 <= kmax) ddg_coef[j] = (j + 2.0) * (j + 1.0) * deg_dist[j + 2];
+            }
+            truncated_max_deg = kmax;
+
+            block_tail.assign(n / PGF_LANES + 1, 0.0);
+            for (int j = n - 1; j >= 0; j--) {
+                block_tail[j / PGF_LANES] += fabs(g_coef[j]) + fabs(dg_coef[j]) + fabs(ddg_coef[j]);
+            }
+            for (int b = n / PGF_LANES - 1; b >= 0; b--) block_tail[b] += block_tail[b + 1];
+        }
 
     public:
-        Deterministic_Network_SIR_Sim() : r(0.0), mu(0.0) { nbins=4;}
-        Deterministic_Network_SIR_Sim(double r_param, double mu_param, vector<double> deg_dist_param):
+        Deterministic_Network_SIR_Sim() : r(0.0), mu(0.0) { nbins=4; tail_tolerance=1e-12; prepare_pgf(); }
+        Deterministic_Network_SIR_Sim(double r_param, double mu_param, vector<double> deg_dist_param, double tail_tol = 1e-12):
             r(r_param), 
             mu(mu_param), 
-            deg_dist(deg_dist_param) { 
+            deg_dist(deg_dist_param),
+            tail_tolerance(tail_tol) {
                 nbins=4; 
+                prepare_pgf();
             }
         ~Deterministic_Network_SIR_Sim() {};
 
+        // for reusing one instance across parameter values; follow with initialize()
+        void set_parameters(double r_param, double mu_param, const vector<double>& deg_dist_param) {
+            r = r_param;
+            mu = mu_param;
+            deg_dist = deg_dist_param;
+            prepare_pgf();
+        }
+
+        // largest possible error in g, g' or g'' from truncating the degree distribution
+        double get_truncation_error() { return truncation_error; }
+        int get_truncated_max_deg() { return truncated_max_deg; }
+
         void initialize( double theta, double pS, double pI, double I) {
-            y = new double[nbins];
+            init_state();
             y[0] = theta; 
             y[1] = pS; 
             y[2] = pI;
@@ -38,28 +113,54 @@ class Deterministic_Network_SIR_Sim : public DiffEq_Sim {
         double current_infectious() { return y[3]; }
         double current_recovered() { return 1.0 - current_susceptible() - current_infectious(); }
 
-        double g( double theta) {
-            double val = 0;
-            for (unsigned int i = 0; i<deg_dist.size(); i++) {
-                val += deg_dist[i] * pow(theta,i);
+        // g(theta), g'(theta) and g''(theta) in one pass, without pow()
+        void pgf(double theta, double& g_val, double& dg_val, double& ddg_val) const {
+            double step[PGF_LANES];     // theta^0 ... theta^(PGF_LANES-1)
+            step[0] = 1.0;
+            for (int l = 1; l < PGF_LANES; l++) step[l] = step[l-1] * theta;
+            const double stride = step[PGF_LANES - 1] * theta;
+
+            double acc_g[PGF_LANES], acc_dg[PGF_LANES], acc_ddg[PGF_LANES];
+            for (int l = 0; l < PGF_LANES; l++) { acc_g[l] = 0; acc_dg[l] = 0; acc_ddg[l] = 0; }
+
+            // For theta < 1, the powers eventually underflow.  Stop before they
+            // become subnormal (and slow): once the remaining terms can't add
+            // up to 1e-300, they can't change the result.
+            double base = 1.0;          // theta^j0
+            for (unsigned int j0 = 0; j0 < g_coef.size(); j0 += PGF_LANES) {
+                if (base * block_tail[j0 / PGF_LANES] < 1e-300) break;
+                const double* a = &g_coef[j0];
+                const double* b = &dg_coef[j0];
+                const double* c = &ddg_coef[j0];
+                for (int l = 0; l < PGF_LANES; l++) {
+                    const double power = base * step[l];
+                    acc_g[l]   += a[l] * power;
+                    acc_dg[l]  += b[l] * power;
+                    acc_ddg[l] += c[l] * power;
+                }
+                base *= stride;
             }
+
+            g_val = 0; dg_val = 0; ddg_val = 0;
+            for (int l = 0; l < PGF_LANES; l++) { g_val += acc_g[l]; dg_val += acc_dg[l]; ddg_val += acc_ddg[l]; }
+        }
+
+        double g( double theta) {
+            double val, dval, ddval;
+            pgf(theta, val, dval, ddval);
             return val;
         }
 
         double dg( double theta) {
-            double val = 0;
-            for (unsigned int i = 1; i<deg_dist.size(); i++) {
-                val += (i) * deg_dist[i] * pow(theta,i-1);
-            }
-            return val;
+            double val, dval, ddval;
+            pgf(theta, val, dval, ddval);
+            return dval;
         }
 
         double ddg( double theta) {
-            double val = 0;
-            for (unsigned int i = 2; i<deg_dist.size(); i++) {
-                val += (i) * (i-1) *deg_dist[i] * pow(theta,i-2);
-            }
-            return val;
+            double val, dval, ddval;
+            pgf(theta, val, dval, ddval);
+            return ddval;
         }
 
         void derivative(double const y[], double dydt[]) {
@@ -67,12 +168,14 @@ class Deterministic_Network_SIR_Sim : public DiffEq_Sim {
             const double pS = y[1];
             const double pI = y[2];
             const double I = y[3];
+            double g_theta, dg_theta, ddg_theta;
+            pgf(theta, g_theta, dg_theta, ddg_theta);
 
             dydt[0] = -r * pI * theta;                                                  // dtheta.dt
-            dydt[1] = r *  pS * pI * (1 - theta * ddg(theta)/dg(theta));                // dpS.dt
-            dydt[2] = r *  pI * pS * theta * ddg(theta)/dg(theta) - pI*(1-pI)*r- pI*mu; // dpI.dt
+            dydt[1] = r *  pS * pI * (1 - theta * ddg_theta/dg_theta);                  // dpS.dt
+            dydt[2] = r *  pI * pS * theta * ddg_theta/dg_theta - pI*(1-pI)*r- pI*mu;   // dpI.dt
 
-            dydt[3] = r * pI * theta * dg(theta) - mu*I;
+            dydt[3] = r * pI * theta * dg_theta - mu*I;
         }
 
 };
@@ -5,32 +5,380 @@
 #include <gsl/gsl_errno.h>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <float.h>
+#include <functional>
 
 using namespace std;
 
+// The state vector (y) and the GSL solver workspaces belong to the simulator
+// and are reused by every run_simulation() and step_simulation() call, so a
+// single instance can be stepped a day at a time, or re-initialized with new
+// parameters, as often as needed without allocating anything.  Derived classes
+// should call init_state() at the start of initialize() to reset the clock and
+// the solver, and then fill in y.
+//
+// Stiff systems (e.g. fast stage progression alongside slow demography) can use
+// a linearly implicit solver instead of RKF45: set_solver(ROSENBROCK) selects
+// the Rosenbrock 2(3) method of Shampine & Reichelt (MATLAB's ode23s), which is
+// L-stable and needs one LU factorization per step.  By default its Jacobian
+// is found by finite differences (nbins derivative() calls).  A derived class
+// with a sparse Jacobian should describe the nonzero pattern once with
+// set_jacobian_pattern(), and then either override jacobian() to fill in the
+// values, or let the pattern be used to perturb many variables at once, so the
+// finite differences take only as many derivative() calls as the largest
+// number of variables that any one equation depends on (roughly).
 
 class DiffEq_Sim {
+    public:
+        typedef enum {
+            RKF45, ROSENBROCK
+        } solverType;
+
+        // (std:: because of the static member function() below)
+        typedef std::function<double (double t, const double y[], const double dydt[])> eventFunction;
+
+        // An event happens when value(t, y, dydt) crosses zero: from above if
+        // direction is -1, from below if +1, or either way if 0.  A terminal
+        // event ends the run.
+        class ODE_Event {
+            public:
+                eventFunction value;
+                int direction;
+                bool terminal;
+        };
+
+        class ODE_Event_Record {
+            public:
+                int event;              // as returned by add_event()
+                double time;
+                vector<double> state;
+        };
+
     private:
-        double t;      //initial time 
+        double t;      //initial time
         double h;      //time step
         double tmax;   //max time
         double hmin;
 
+        vector<double> state;
+        gsl_odeiv_evolve*  evolve;
+        gsl_odeiv_control* control;
+        gsl_odeiv_step*    stepper;
+        size_t workspace_size;
+
+        solverType solver;
+        double run_eps_abs;         // step-size control: |error| < eps_abs + eps_rel * |y|
+        double step_eps_abs;
+        double eps_rel;
+
+        // Jacobian, in compressed sparse row form, if the pattern is known
+        vector<int> jac_offsets;
+        vector<int> jac_cols;
+        vector<double> jac_values;
+        bool jac_analytic;
+        vector<int> jac_color;      // columns of the same color share no rows
+        int jac_num_colors;
+
+        vector<ODE_Event> events;
+        vector<ODE_Event_Record> event_log;
+
+        // Rosenbrock workspace
+        vector<double> J;           // dense Jacobian, row-major
+        vector<double> W;           // LU factors of I - h*d*J
+        vector<int> pivot;
+        vector<double> F0, F1, F2, k1, k2, k3, ytmp, ynew;
+        bool F0_current;            // F0 = f(y), from the last accepted step
+        bool J_current;             // J is for the current y
+
+        void free_workspace() {
+            if (evolve)  gsl_odeiv_evolve_free(evolve);
+            if (control) gsl_odeiv_control_free(control);
+            if (stepper) gsl_odeiv_step_free(stepper);
+            evolve = NULL; control = NULL; stepper = NULL;
+            workspace_size = 0;
+        }
+
+        // (Re)allocate the solver only if the system has changed size, and set
+        // the absolute error tolerance for this run
+        void prepare_workspace(double eps_abs) {
+            if (workspace_size != nbins) {
+                free_workspace();
+                evolve  = gsl_odeiv_evolve_alloc(nbins);
+                control = gsl_odeiv_control_y_new(eps_abs, eps_rel);
+                stepper = gsl_odeiv_step_alloc(gsl_odeiv_step_rkf45, nbins);
+                workspace_size = nbins;
+            } else {
+                gsl_odeiv_control_init(control, eps_abs, eps_rel, 1, 0);
+            }
+        }
+
+        void prepare_rosenbrock() {
+            if (J.size() == nbins * nbins) return;
+            J.assign(nbins * nbins, 0.0);
+            W.assign(nbins * nbins, 0.0);
+            pivot.assign(nbins, 0);
+            F0.assign(nbins, 0.0); F1 = F0; F2 = F0;
+            k1 = F0; k2 = F0; k3 = F0; ytmp = F0; ynew = F0;
+            F0_current = false;
+            J_current = false;
+        }
+
+        // Greedy coloring of the Jacobian's columns, for grouped finite differences
+        void color_jacobian_columns() {
+            const int n = nbins;
+            vector< vector<int> > col_rows(n);
+            for (int i = 0; i < n; i++) {
+                for (int e = jac_offsets[i]; e < jac_offsets[i+1]; e++) col_rows[ jac_cols[e] ].push_back(i);
+            }
+            jac_color.assign(n, -1);
+            jac_num_colors = 0;
+            vector<int> used_by(n, -1);     // used_by[color] == j if a neighbor of j has that color
+            for (int j = 0; j < n; j++) {
+                for (unsigned int a = 0; a < col_rows[j].size(); a++) {
+                    const int i = col_rows[j][a];
+                    for (int e = jac_offsets[i]; e < jac_offsets[i+1]; e++) {
+                        const int c = jac_color[ jac_cols[e] ];
+                        if (c >= 0) used_by[c] = j;
+                    }
+                }
+                int c = 0;
+                while (used_by[c] == j) c++;
+                jac_color[j] = c;
+                jac_num_colors = max(jac_num_colors, c + 1);
+            }
+        }
+
+        void compute_jacobian() {
+            const int n = nbins;
+            fill(J.begin(), J.end(), 0.0);
+            if (jac_offsets.size() > 0 and jac_analytic) {
+                jacobian(y, &jac_values[0]);
+                for (int i = 0; i < n; i++) {
+                    for (int e = jac_offsets[i]; e < jac_offsets[i+1]; e++) J[i*n + jac_cols[e]] = jac_values[e];
+                }
+                return;
+            }
+
+            // finite differences; without a pattern, every column gets its own color
+            const bool sparse = jac_offsets.size() > 0;
+            const int num_colors = sparse ? jac_num_colors : n;
+            vector<double>& delta = k3;     // free at this point
+            for (int c = 0; c < num_colors; c++) {
+                for (int j = 0; j < n; j++) {
+                    ytmp[j] = y[j];
+                    if ((sparse ? jac_color[j] : j) == c) {
+                        delta[j] = sqrt(DBL_EPSILON) * max(fabs(y[j]), 1e-6);
+                        ytmp[j] += delta[j];
+                    }
+                }
+                derivative(&ytmp[0], &F1[0]);
+                if (sparse) {
+                    for (int i = 0; i < n; i++) {
+                        for (int e = jac_offsets[i]; e < jac_offsets[i+1]; e++) {
+                            const int j = jac_cols[e];
+                            if (jac_color[j] == c) J[i*n + j] = (F1[i] - F0[i]) / delta[j];
+                        }
+                    }
+                } else {
+                    for (int i = 0; i < n; i++) J[i*n + c] = (F1[i] - F0[i]) / delta[c];
+                }
+            }
+        }
+
+        // LU factorization of W = I - gamma*J with partial pivoting.  Zero
+        // multipliers are skipped, so sparse W costs much less than n^3.
+        bool factor(double gamma) {
+            const int n = nbins;
+            for (int i = 0; i < n*n; i++) W[i] = -gamma * J[i];
+            for (int i = 0; i < n; i++) W[i*n + i] += 1.0;
+
+            for (int k = 0; k < n; k++) {
+                int p = k;
+                for (int i = k + 1; i < n; i++) if (fabs(W[i*n + k]) > fabs(W[p*n + k])) p = i;
+                pivot[k] = p;
+                if (W[p*n + k] == 0.0) return false;
+                if (p != k) for (int j = k; j < n; j++) swap(W[k*n + j], W[p*n + j]); // (solve() swaps b as it goes)
+
+                const double inv = 1.0 / W[k*n + k];
+                for (int i = k + 1; i < n; i++) {
+                    double& m = W[i*n + k];
+                    if (m == 0.0) continue;
+                    m *= inv;
+                    for (int j = k + 1; j < n; j++) W[i*n + j] -= m * W[k*n + j];
+                }
+            }
+            return true;
+        }
+
+        void solve(vector<double>& b) {
+            const int n = nbins;
+            for (int k = 0; k < n; k++) {
+                if (pivot[k] != k) swap(b[k], b[ pivot[k] ]);
+                const double bk = b[k];
+                if (bk != 0.0) for (int i = k + 1; i < n; i++) b[i] -= W[i*n + k] * bk;
+            }
+            for (int k = n - 1; k >= 0; k--) {
+                double s = b[k];
+                for (int j = k + 1; j < n; j++) s -= W[k*n + j] * b[j];
+                b[k] = s / W[k*n + k];
+            }
+        }
+
+        // One accepted Rosenbrock step (retrying as needed), ending no later than tstop
+        int rosenbrock_step(double tstop, double eps_abs) {
+            static const double d   = 1.0 / (2.0 + sqrt(2.0));
+            static const double e32 = 6.0 + sqrt(2.0);
+            const int n = nbins;
+
+            while (true) {
+                const double hs = min(h, tstop - t);
+                if (hs <= 1e-14 * max(1.0, fabs(t))) return GSL_FAILURE;
+
+                if (not F0_current) { derivative(y, &F0[0]); F0_current = true; }
+                if (not J_current)  { compute_jacobian(); J_current = true; }
+                if (not factor(hs * d)) { h = 0.5 * hs; continue; }
+
+                for (int i = 0; i < n; i++) k1[i] = F0[i];
+                solve(k1);
+                for (int i = 0; i < n; i++) ytmp[i] = y[i] + 0.5 * hs * k1[i];
+                derivative(&ytmp[0], &F1[0]);
+                for (int i = 0; i < n; i++) k2[i] = F1[i] - k1[i];
+                solve(k2);
+                for (int i = 0; i < n; i++) { k2[i] += k1[i]; ynew[i] = y[i] + hs * k2[i]; }
+                derivative(&ynew[0], &F2[0]);
+                for (int i = 0; i < n; i++) k3[i] = F2[i] - e32 * (k2[i] - F1[i]) - 2.0 * (k1[i] - F0[i]);
+                solve(k3);
+
+                double rmax = 0;
+                for (int i = 0; i < n; i++) {
+                    const double err = hs / 6.0 * (k1[i] - 2.0 * k2[i] + k3[i]);
+                    const double D0  = eps_abs + eps_rel * max(fabs(y[i]), fabs(ynew[i]));
+                    rmax = max(rmax, fabs(err) / D0);
+                }
+                const double r = rmax > 0 ? 0.9 * pow(rmax, -1.0/3.0) : 5.0;
+                if (rmax > 1.0) {                   // reject
+                    h = hs * max(r, 0.2);
+                    continue;
+                }
+                for (int i = 0; i < n; i++) { y[i] = ynew[i]; F0[i] = F2[i]; }
+                J_current = false;
+                const bool clipped = hs < h;  // (shortened to land on tstop)
+                t = clipped ? tstop : t + hs;
+                h = clipped ? max(h, hs * min(r, 5.0)) : hs * min(r, 5.0);
+                return 0;
+            }
+        }
+
+        int rosenbrock_apply(double tstop, double eps_abs) {
+            prepare_rosenbrock();
+            F0_current = false;             // y may have been changed since the last call
+            J_current = false;
+            while (t < tstop) {
+                int status = rosenbrock_step(tstop, eps_abs);
+                if (status != 0) return status;
+            }
+            return 0;
+        }
+
+        // Cubic Hermite interpolation between (t0, y0, f0) and (t1, y1, f1)
+        void interpolate(double tau, double t0, const double* y0, const double* f0,
+                         double t1, const double* y1, const double* f1, double* out) {
+            const double dt = t1 - t0;
+            const double th = (tau - t0) / dt;
+            const double th2 = th * th, th3 = th2 * th;
+            const double h00 = 2*th3 - 3*th2 + 1, h10 = th3 - 2*th2 + th;
+            const double h01 = -2*th3 + 3*th2,   h11 = th3 - th2;
+            for (size_t i = 0; i < nbins; i++) {
+                out[i] = h00 * y0[i] + h10 * dt * f0[i] + h01 * y1[i] + h11 * dt * f1[i];
+            }
+        }
+
+        bool crosses(const ODE_Event& e, double g0, double g1) {
+            return (e.direction >= 0 and g0 < 0 and g1 >= 0) or (e.direction <= 0 and g0 > 0 and g1 <= 0);
+        }
+
+        // Where event e's value crosses zero within a step, by the Illinois
+        // variant of regula falsi on the interpolated solution.  The state there
+        // is left in yi.
+        double find_event_time(const ODE_Event& e, double t0, const double* y0, const double* f0, double g0,
+                               double t1, const double* y1, const double* f1, double g1,
+                               vector<double>& yi, vector<double>& fi) {
+            double a = t0, b = t1, ga = g0, gb = g1;
+            int side = 0;
+            for (int iter = 0; iter < 100 and b - a > 1e-12 * max(1.0, fabs(b)); iter++) {
+                const double c = (a * gb - b * ga) / (gb - ga);
+                interpolate(c, t0, y0, f0, t1, y1, f1, &yi[0]);
+                derivative(&yi[0], &fi[0]);
+                const double gc = e.value(c, &yi[0], &fi[0]);
+                if ((gc < 0) == (gb < 0) and gc != 0) {     // root is in [a, c]
+                    b = c; gb = gc;
+                    if (side == -1) ga /= 2;
+                    side = -1;
+                } else if (gc == 0) {
+                    a = b = c;
+                } else {                                    // root is in [c, b]
+                    a = c; ga = gc;
+                    if (side == 1) gb /= 2;
+                    side = 1;
+                }
+            }
+            interpolate(b, t0, y0, f0, t1, y1, f1, &yi[0]);
+            return b;
+        }
+
     public:
         DiffEq_Sim() {
-            t    = 0.0;      //initial time 
+            t    = 0.0;      //initial time
             h    = 0.1;     //time step
             tmax = 2000;
             hmin = 0.2;
+            nbins = 0;
+            y = NULL;
+            evolve = NULL; control = NULL; stepper = NULL;
+            workspace_size = 0;
+            solver = RKF45;
+            run_eps_abs = 1e-20;
+            step_eps_abs = 1e-5;
+            eps_rel = 0;
+            jac_analytic = false;
+            jac_num_colors = 0;
+            F0_current = false;
+            J_current = false;
         };
 
-        ~DiffEq_Sim() {};
+        // copies get their own state and workspaces
+        DiffEq_Sim(const DiffEq_Sim& o) {
+            evolve = NULL; control = NULL; stepper = NULL;
+            workspace_size = 0;
+            *this = o;
+        }
+
+        DiffEq_Sim& operator=(const DiffEq_Sim& o) {
+            if (this == &o) return *this;
+            t = o.t; h = o.h; tmax = o.tmax; hmin = o.hmin;
+            nbins = o.nbins;
+            state = o.state;
+            y = o.y ? state.data() : NULL;
+            free_workspace();
+            solver = o.solver;
+            run_eps_abs = o.run_eps_abs; step_eps_abs = o.step_eps_abs; eps_rel = o.eps_rel;
+            jac_offsets = o.jac_offsets; jac_cols = o.jac_cols; jac_values = o.jac_values;
+            jac_analytic = o.jac_analytic; jac_color = o.jac_color; jac_num_colors = o.jac_num_colors;
+            events = o.events;
+            J.clear();
+            return *this;
+        }
+
+        virtual ~DiffEq_Sim() { free_workspace(); };
 
         size_t nbins;
         double* y;
 
-        void printY() { for(int i=0; i < nbins; i++) { cout << y[i] << " ";} cout << endl; }
-        
+        void printY() { for(size_t i=0; i < nbins; i++) { cout << y[i] << " ";} cout << endl; }
+
         vector<double> get_state() {
             vector<double> C;
             C.assign(y, y + nbins);
@@ -39,9 +387,47 @@ class DiffEq_Sim {
 
         double get_time() { return t; }
 
+        // Zero the clock and the state vector (sized to nbins), and forget the
+        // solver's step history.  Workspaces are kept.
+        void init_state() {
+            t = 0.0;
+            h = 0.1;
+            state.assign(nbins, 0.0);
+            y = state.data();
+            if (evolve and workspace_size == nbins) {
+                gsl_odeiv_evolve_reset(evolve);
+                gsl_odeiv_step_reset(stepper);
+            }
+            F0_current = false;
+            J_current = false;
+        }
+
+        void set_solver(solverType s) { solver = s; }
+
+        // By default, run_simulation() uses an absolute tolerance of 1e-20 and
+        // step_simulation() 1e-5, with no relative tolerance.  This sets both.
+        void set_tolerances(double abs, double rel) {
+            run_eps_abs = abs;
+            step_eps_abs = abs;
+            eps_rel = rel;
+        }
+
+        // Nonzero pattern of d(dydt[i])/dy[j], by row: the columns of row i are
+        // cols[ row_offsets[i] ] ... cols[ row_offsets[i+1] - 1 ].  If analytic,
+        // jacobian() must be overridden to fill in the values in that order.
+        void set_jacobian_pattern(const vector<int>& row_offsets, const vector<int>& cols, bool analytic) {
+            assert(row_offsets.size() == nbins + 1 and (size_t) row_offsets.back() == cols.size());
+            jac_offsets = row_offsets;
+            jac_cols = cols;
+            jac_values.assign(cols.size(), 0.0);
+            jac_analytic = analytic;
+            if (not analytic) color_jacobian_columns();
+            J_current = false;
+        }
 
         virtual void initialize() {}
         virtual void derivative(const double y[], double dydt[]){}
+        virtual void jacobian(const double y[], double values[]) {}
 
         static int function(double t, double const y[], double dydt[], void *params) {
             DiffEq_Sim* model = static_cast <DiffEq_Sim*> (params);
@@ -50,27 +436,129 @@ class DiffEq_Sim {
         }
 
 
+        // Events are checked by run_simulation(tstop, times, output)
+        int add_event(eventFunction value, int direction = 0, bool terminal = false) {
+            ODE_Event e;
+            e.value = value;
+            e.direction = direction;
+            e.terminal = terminal;
+            events.push_back(e);
+            return events.size() - 1;
+        }
+
+        // y[i] reaches a local maximum (e.g. peak prevalence)
+        int add_peak_event(int i, bool terminal = false) {
+            return add_event([i](double, const double*, const double dydt[]) { return dydt[i]; }, -1, terminal);
+        }
+
+        // y[i] crosses level, going up (+1), down (-1) or either way (0)
+        int add_threshold_event(int i, double level, int direction = 0, bool terminal = false) {
+            return add_event([i, level](double, const double y[], const double*) { return y[i] - level; }, direction, terminal);
+        }
+
+        void clear_events() { events.clear(); event_log.clear(); }
+
+        // events found by the last run_simulation(tstop, times, output), in time order
+        const vector<ODE_Event_Record>& get_event_log() { return event_log; }
+
+        // Integrate to tstop in one run, with step_simulation()'s tolerances, and
+        // record the state at each of the (increasing) output times from a cubic
+        // Hermite interpolant across each step, so output times don't limit the
+        // step size.  Events are located to within about 1e-12 of their time.  If
+        // a terminal event happens, the run (and output) stops there.
+        int run_simulation(double tstop, const vector<double>& times, vector< vector<double> >& output) {
+            const int n = nbins;
+            output.clear();
+            event_log.clear();
+            if (solver == ROSENBROCK) {
+                prepare_rosenbrock();
+                F0_current = false;
+                J_current = false;
+            } else {
+                prepare_workspace(step_eps_abs);
+            }
+            gsl_odeiv_system sys = {function, NULL, nbins, this };
+
+            vector<double> y0(y, y + n), f0(n), f1(n), yi(n), fi(n);
+            derivative(y, &f0[0]);
+            vector<double> g0(events.size()), g1(events.size());
+            for (unsigned int k = 0; k < events.size(); k++) g0[k] = events[k].value(t, y, &f0[0]);
+
+            unsigned int next = 0;
+            while (next < times.size() and times[next] < t) next++;
+            while (next < times.size() and times[next] == t) { output.push_back(y0); next++; }
+
+            while (t < tstop) {
+                const double t0 = t;
+                int status = solver == ROSENBROCK ? rosenbrock_step(tstop, step_eps_abs)
+                                                  : gsl_odeiv_evolve_apply(evolve, control, stepper, &sys, &t, tstop, &h, y);
+                if (status != GSL_SUCCESS) return status;
+                derivative(y, &f1[0]);
+
+                // events in this step, earliest first, up to the first terminal one
+                vector< pair<double, int> > found;
+                for (unsigned int k = 0; k < events.size(); k++) {
+                    g1[k] = events[k].value(t, y, &f1[0]);
+                    if (crosses(events[k], g0[k], g1[k])) {
+                        found.push_back( make_pair(find_event_time(events[k], t0, &y0[0], &f0[0], g0[k], t, y, &f1[0], g1[k], yi, fi), k) );
+                    }
+                }
+                sort(found.begin(), found.end());
+                double t_end = t;
+                bool stop = false;
+                for (unsigned int a = 0; a < found.size() and not stop; a++) {
+                    ODE_Event_Record rec;
+                    rec.event = found[a].second;
+                    rec.time = found[a].first;
+                    rec.state.resize(n);
+                    interpolate(rec.time, t0, &y0[0], &f0[0], t, y, &f1[0], &rec.state[0]);
+                    event_log.push_back(rec);
+                    if (events[rec.event].terminal) { t_end = rec.time; stop = true; }
+                }
+
+                while (next < times.size() and times[next] <= t_end) {
+                    vector<double> out(n);
+                    if (times[next] == t) out.assign(y, y + n);
+                    else interpolate(times[next], t0, &y0[0], &f0[0], t, y, &f1[0], &out[0]);
+                    output.push_back(out);
+                    next++;
+                }
+
+                if (stop) {
+                    interpolate(t_end, t0, &y0[0], &f0[0], t, y, &f1[0], &yi[0]);
+                    for (int i = 0; i < n; i++) y[i] = yi[i];
+                    t = t_end;
+                    if (evolve) gsl_odeiv_evolve_reset(evolve);   // there is none under ROSENBROCK
+                    F0_current = false;
+                    J_current = false;
+                    return 0;
+                }
+                y0.assign(y, y + n);
+                f0 = f1;
+                g0 = g1;
+            }
+            return 0;
+        }
+
         int run_simulation() {
-            gsl_odeiv_evolve*  e = gsl_odeiv_evolve_alloc(nbins);
-            gsl_odeiv_control* c = gsl_odeiv_control_y_new(1e-20, 0);
-            gsl_odeiv_step*    s = gsl_odeiv_step_alloc(gsl_odeiv_step_rkf45, nbins);
+            if (solver == ROSENBROCK) return rosenbrock_apply(tmax, run_eps_abs);
+            prepare_workspace(run_eps_abs);
             gsl_odeiv_system sys = {function, NULL, nbins, this };
             while (t < tmax) {  //convergence check here
-                int status = gsl_odeiv_evolve_apply(e, c, s, &sys, &t, tmax, &h, y);
+                int status = gsl_odeiv_evolve_apply(evolve, control, stepper, &sys, &t, tmax, &h, y);
                 if (status != GSL_SUCCESS) { return status; }
             }
             return 0;
         }
 
        int step_simulation( double stepsize ) {
-            gsl_odeiv_evolve*  e = gsl_odeiv_evolve_alloc(nbins);
-            gsl_odeiv_control* c = gsl_odeiv_control_y_new(1e-5, 0);
-            gsl_odeiv_step*    s = gsl_odeiv_step_alloc(gsl_odeiv_step_rkf45, nbins);
+            double tstop = t+stepsize;
+            if (solver == ROSENBROCK) return rosenbrock_apply(tstop, step_eps_abs);
+            prepare_workspace(step_eps_abs);
             gsl_odeiv_system sys = {function, NULL, nbins, this };
 
-            double tstop = t+stepsize;
             while (t < tstop) {
-                int status = gsl_odeiv_evolve_apply(e, c, s, &sys, &t, tstop, &h, y);
+                int status = gsl_odeiv_evolve_apply(evolve, control, stepper, &sys, &t, tstop, &h, y);
                 if (status != GSL_SUCCESS) { return status; }
             }
             return 0;
@@ -0,0 +1,344 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include "Network.h"
+#include "Adjacency.h"
+#include "ChainBinomial_Sim.h"
+#include "Utility.h"
+
+using namespace std;
+
+/******************************************************************************
+ * Runs many replicates of a simulation on the same network in parallel.
+ *
+ * The simulator classes store epidemic state in Node::state, so two of them
+ * can't run on one network at the same time.  The Ensemble instead takes a
+ * read-only Adjacency snapshot of the network, which is shared by all worker
+ * threads, and gives each worker its own state array, scratch space and RNG.
+ *
+ *      Ensemble ens(&my_network);           // one worker per core
+ *      ens.seed(1234);
+ *      ens.run_chain_binomial(1000, 10, 0.05, 1);
+ *      vector<int> sizes = ens.get_epidemic_sizes();
+ *
+ * Replicate r always draws its random numbers from a generator seeded with
+ * (seed, r), so results depend only on the seed, not on the number of threads
+ * or on which thread happened to run which replicate.
+ *
+ * Replicates are handed out with work-stealing: each worker starts with a
+ * contiguous block of replicate indices, and a worker that runs out takes half
+ * of the remaining block of another worker.
+ *
+ * Epi curves are prevalence curves (the number of currently infected nodes at
+ * each time step), which is what the GUI plots.  The percolation and chain
+ * binomial models are stepped once per generation/day; the Gillespie model is
+ * sampled at every whole time unit.
+ *
+ * Progress can be watched, and the run cancelled, through a Progress object
+ * (see set_progress()).  Cancellation takes effect between replicates; those
+ * that were never started have an epidemic size of -1 and an empty curve.
+ *****************************************************************************/
+
+class Ensemble {
+    public:
+        Ensemble(Network* net, int num_threads = 0) {
+            adj.build(net);
+            if (num_threads < 1) num_threads = thread::hardware_concurrency();
+            if (num_threads < 1) num_threads = 1;
+            workers.resize(num_threads);
+            for (unsigned int w = 0; w < workers.size(); w++) workers[w].state.assign(adj.size(), 0);
+            _seed = 0;
+            progress = NULL;
+        }
+
+        void seed(uint32_t s) { _seed = s; }
+        int num_threads() const { return workers.size(); }
+
+        // Reports each run as a "Simulating" phase, counted in replicates
+        void set_progress(Progress* p) { progress = p; }
+
+        // Percolation_Sim: each infected node has one chance to infect each
+        // neighbor, with probability T
+        void run_percolation(int reps, double T, int patients_zero) {
+            run_replicates(reps, [=](Worker& w, vector<int>& curve) {
+                return percolation_replicate(w, curve, T, patients_zero);
+            });
+        }
+
+        // ChainBinomial_Sim: infection can spread along an edge with probability
+        // T on each day of a fixed infectious period
+        void run_chain_binomial(int reps, int infectious_period, double T, int patients_zero) {
+            const Transmission_Delay delay(T, infectious_period);
+            run_replicates(reps, [=, &delay](Worker& w, vector<int>& curve) {
+                return chain_binomial_replicate(w, curve, delay, patients_zero);
+            });
+        }
+
+        // Gillespie_Network_SEIRS_Sim: continuous-time S -> E -> I -> R -> S.
+        // Epidemic size is the total number of infections during the run.
+        void run_gillespie_SEIRS(int reps, double mu, double beta, double gamma, double immunity_duration,
+                                 double duration, int patients_zero) {
+            run_replicates(reps, [=](Worker& w, vector<int>& curve) {
+                return gillespie_SEIRS_replicate(w, curve, mu, beta, gamma, immunity_duration, duration, patients_zero);
+            });
+        }
+
+        vector<int>& get_epidemic_sizes() { return epidemic_sizes; }
+        vector< vector<int> >& get_epi_curves() { return epi_curves; }
+
+    private:
+        typedef enum { S=0, I=1, R=-1 } percStateType;
+        typedef enum { SUSCEPTIBLE, EXPOSED, INFECTIOUS, RESISTANT } seirsStateType;
+
+        struct SEIRS_Event {
+            double time;
+            char type;
+            int node;
+            SEIRS_Event(double t, char e, int n) { time=t; type=e; node=n; }
+            bool operator>(const SEIRS_Event& o) const { return time > o.time; }
+        };
+
+        struct Worker {
+            vector<stateType> state;         // one entry per node
+            vector<int> touched;             // nodes whose state must be reset
+            vector<int> current, next;       // scratch lists of node indices
+            vector<int> sample;
+            vector< vector<int> > calendar;  // pending transmissions, by day
+            mt19937 rng;
+        };
+
+        struct Block {                       // replicates [first, last) waiting to be run
+            mutex m;
+            int first;
+            int last;
+        };
+
+        Adjacency adj;
+        vector<Worker> workers;
+        uint32_t _seed;
+        Progress* progress;     // not owned; may be NULL
+
+        vector<int> epidemic_sizes;
+        vector< vector<int> > epi_curves;
+
+        void run_replicates(int reps, function<int(Worker&, vector<int>&)> replicate) {
+            assert(reps >= 0);
+            epidemic_sizes.assign(reps, -1);
+            epi_curves.assign(reps, vector<int>());
+
+            const int nw = workers.size();
+            vector<Block> blocks(nw);
+            for (int w = 0; w < nw; w++) {
+                blocks[w].first = (long) reps * w / nw;
+                blocks[w].last  = (long) reps * (w + 1) / nw;
+            }
+
+            if (progress) progress->begin_phase("Simulating", reps);
+            auto work = [&](int w) {
+                Worker& worker = workers[w];
+                int rep;
+                while (next_replicate(blocks, w, rep)) {
+                    if (progress and progress->cancelled()) break;
+                    seed_seq seq{ _seed, (uint32_t) rep };
+                    worker.rng.seed(seq);
+                    epidemic_sizes[rep] = replicate(worker, epi_curves[rep]);
+                    for (unsigned int i = 0; i < worker.touched.size(); i++) worker.state[ worker.touched[i] ] = 0;
+                    worker.touched.clear();
+                    if (progress) progress->advance();
+                }
+            };
+
+            vector<thread> threads;
+            for (int w = 1; w < nw; w++) threads.push_back( thread(work, w) );
+            work(0);
+            for (unsigned int t = 0; t < threads.size(); t++) threads[t].join();
+        }
+
+        // Take the next replicate from this worker's block, or steal half of
+        // the largest block belonging to another worker
+        bool next_replicate(vector<Block>& blocks, int w, int& rep) {
+            const int nw = blocks.size();
+            while (true) {
+                {
+                    lock_guard<mutex> lock(blocks[w].m);
+                    if (blocks[w].first < blocks[w].last) {
+                        rep = blocks[w].first++;
+                        return true;
+                    }
+                }
+
+                int victim = -1;
+                int most = 0;
+                for (int v = 0; v < nw; v++) {
+                    if (v == w) continue;
+                    lock_guard<mutex> lock(blocks[v].m);
+                    if (blocks[v].last - blocks[v].first > most) {
+                        most = blocks[v].last - blocks[v].first;
+                        victim = v;
+                    }
+                }
+                if (victim == -1) return false;
+
+                int first, last;
+                {
+                    lock_guard<mutex> lock(blocks[victim].m);
+                    int remaining = blocks[victim].last - blocks[victim].first;
+                    if (remaining == 0) continue; // someone else got there first
+                    last  = blocks[victim].last;
+                    first = last - (remaining + 1) / 2;
+                    blocks[victim].last = first;
+                }
+                lock_guard<mutex> lock(blocks[w].m);
+                blocks[w].first = first;
+                blocks[w].last  = last;
+            }
+        }
+
+        // choose n nodes without replacement
+        vector<int>& rand_choose_nodes(Worker& w, int n) {
+            assert(n > -1 and n <= adj.size());
+            w.sample.resize(n);
+            rand_nchoosek(adj.size(), w.sample, &w.rng);
+            return w.sample;
+        }
+
+        int percolation_replicate(Worker& w, vector<int>& curve, double T, int patients_zero) {
+            vector<int>& infected = w.current;
+            vector<int>& new_infected = w.next;
+            infected = rand_choose_nodes(w, patients_zero);
+            for (unsigned int i = 0; i < infected.size(); i++) {
+                w.state[ infected[i] ] = I;
+                w.touched.push_back( infected[i] );
+            }
+            curve.push_back(infected.size());
+
+            int recovered = 0;
+            while (infected.size() > 0) {
+                new_infected.clear();
+                for (unsigned int i = 0; i < infected.size(); i++) {
+                    const int inode = infected[i];
+                    for (int e = adj.begin(inode); e < adj.end(inode); e++) {
+                        const int test = adj.neighbors[e];
+                        if ( w.state[test] == S && rand_uniform(0, 1, &w.rng) < T ) {
+                            w.state[test] = I;
+                            w.touched.push_back(test);
+                            new_infected.push_back(test);
+                        }
+                    }
+                    w.state[inode] = R;
+                    recovered++;
+                }
+                infected.swap(new_infected);
+                curve.push_back(infected.size());
+            }
+            return recovered;
+        }
+
+        int chain_binomial_replicate(Worker& w, vector<int>& curve, const Transmission_Delay& delay, int patients_zero) {
+            // States follow ChainBinomial_Sim: 0 is susceptible, 1 ... infectious_period
+            // is the day of infection, and -1 is recovered.  Transmissions are kept in
+            // a calendar of infectious_period+1 daily buckets, as in ChainBinomial_Sim.
+            const int infectious_period = delay.infectious_period;
+            const int days = infectious_period + 1;
+            w.calendar.resize(days);
+            vector<int>& infected = w.current;   // in order of infection
+            infected.clear();
+            unsigned int first_infected = 0;     // earlier entries have recovered
+            int time = 0;
+
+            auto infect_node = [&](int node) {
+                if (w.state[node] != 0) return;  // already infected or recovered
+                w.state[node] = 1;
+                w.touched.push_back(node);
+                infected.push_back(node);
+                int skip = delay.rand_skip(&w.rng);
+                for (int e = adj.begin(node); e < adj.end(node); e++) {
+                    const int neighbor = adj.neighbors[e];
+                    if (w.state[neighbor] != 0) continue;
+                    if (skip-- > 0) continue;
+                    w.calendar[(time + delay.rand_conditional_delay(&w.rng)) % days].push_back(neighbor);
+                    skip = delay.rand_skip(&w.rng);
+                }
+            };
+
+            vector<int>& patients = rand_choose_nodes(w, patients_zero);
+            for (unsigned int i = 0; i < patients.size(); i++) infect_node(patients[i]);
+            curve.push_back(infected.size() - first_infected);
+
+            while (infected.size() > first_infected) {
+                time++;
+                for (unsigned int i = first_infected; i < infected.size(); i++) w.state[ infected[i] ]++;
+                while (first_infected < infected.size() and w.state[ infected[first_infected] ] > infectious_period) {
+                    w.state[ infected[first_infected++] ] = -1;
+                }
+                vector<int>& today = w.calendar[time % days];
+                for (unsigned int i = 0; i < today.size(); i++) infect_node(today[i]);
+                today.clear();
+                curve.push_back(infected.size() - first_infected);
+            }
+            return first_infected;
+        }
+
+        int gillespie_SEIRS_replicate(Worker& w, vector<int>& curve, double mu, double beta, double gamma,
+                                      double immunity_duration, double duration, int patients_zero) {
+            priority_queue<SEIRS_Event, vector<SEIRS_Event>, greater<SEIRS_Event> > EventQ;
+            double Now = 0.0;
+            int infections = 0;
+            int prevalence = 0;                  // E + I
+
+            // Each node has at most one queued event, as in the NEXT_REACTION mode of
+            // Gillespie_Network_SEIRS_Sim: an infectious node's next event is the
+            // first of its next contact and its recovery.
+            auto add_infectious_event = [&](int node) {
+                double T = rand_exp(beta + gamma, &w.rng) + Now;
+                char type = rand_uniform(0, 1, &w.rng) * (beta + gamma) < beta ? 'c' : 'r';
+                EventQ.push( SEIRS_Event(T, type, node) );
+            };
+
+            auto infect = [&](int node) {
+                w.state[node] = EXPOSED;
+                w.touched.push_back(node);
+                infections++;
+                prevalence++;
+                EventQ.push( SEIRS_Event(rand_exp(mu, &w.rng) + Now, 'i', node) );
+            };
+
+            vector<int>& patients = rand_choose_nodes(w, patients_zero);
+            for (unsigned int i = 0; i < patients.size(); i++) infect(patients[i]);
+            curve.push_back(prevalence);
+
+            int day = 0;
+            while ( not EventQ.empty() and EventQ.top().time < duration ) {
+                SEIRS_Event event = EventQ.top();
+                EventQ.pop();
+                while ((int) event.time > day) { curve.push_back(prevalence); day++; }
+                Now = event.time;
+
+                const int node = event.node;
+                if (event.type == 'i') {
+                    w.state[node] = INFECTIOUS;
+                    add_infectious_event(node);
+                } else if (event.type == 'r') {
+                    w.state[node] = RESISTANT;
+                    prevalence--;
+                    EventQ.push( SEIRS_Event(Now + immunity_duration, 's', node) );
+                } else if (event.type == 's') {
+                    w.state[node] = SUSCEPTIBLE;
+                } else {                         // contact
+                    if (adj.deg(node) > 0) {
+                        int contact = adj.neighbors[ adj.begin(node) + rand_uniform_int(0, adj.deg(node) - 1, &w.rng) ];
+                        if ( w.state[contact] == SUSCEPTIBLE ) infect(contact);
+                    }
+                    add_infectious_event(node);
+                }
+            }
+            return infections;
+        }
+};
+
+#endif
@@ -5,42 +5,71 @@
 #include <vector>
 #include <iostream>
 #include <queue>
+#include <limits>
+#include <math.h>
 #include "Utility.h"
 #include "Network.h"
 
 using namespace std;
 
-class Event {
+class MassAction_Event {
     public:
         double time;
         char type;
-        Event(const Event& o) {  time = o.time; type=o.type; }
-        Event(double t, char e) { time=t; type=e; }
-        Event& operator=(const Event& o) { time = o.time; type=o.type; return *this; }
+        MassAction_Event(const MassAction_Event& o) {  time = o.time; type=o.type; }
+        MassAction_Event(double t, char e) { time=t; type=e; }
+        MassAction_Event& operator=(const MassAction_Event& o) { time = o.time; type=o.type; return *this; }
 };
 
-class compTime {
+class MassAction_compTime {
     public:
-        bool operator() (const Event* lhs, const Event* rhs) const {
+        bool operator() (const MassAction_Event* lhs, const MassAction_Event* rhs) const {
             return (lhs->time>rhs->time);
         }
 
-        bool operator() (const Event& lhs, const Event& rhs) const {
+        bool operator() (const MassAction_Event& lhs, const MassAction_Event& rhs) const {
             return (lhs.time>rhs.time);
         }
 };
 
 class Gillespie_MassAction_Sim {
     public:
+        // EVENT_QUEUE: every contact of every infected individual is queued as a
+        //     separate event when that individual is infected.
+        // COMPARTMENT_COUNTS: Gillespie's direct method on the compartment counts.
+        //     Infection happens at rate BETA*S*I/(N-1) and recovery at rate GAMMA*I,
+        //     so only the counts need to be stored, no matter how large N is.
+        //     The process (and so the final size distribution) is the same; contacts
+        //     with non-susceptibles, which have no effect, are just never drawn.
+        // TAU_LEAPING: approximate, for very large outbreaks.  Time advances in
+        //     leaps of length tau, chosen as in Cao, Gillespie & Petzold (2006) so
+        //     that no propensity changes by more than a fraction tau_epsilon of its
+        //     value.  The numbers of infections and recoveries in a leap are drawn
+        //     binomially from S and I, so counts can't go negative.  While fewer
+        //     than critical_infecteds are infected, or when a leap would only
+        //     cover a few events anyway, single exact steps are taken instead,
+        //     so extinction behaves as in the exact engines.
+        typedef enum {
+            EVENT_QUEUE, COMPARTMENT_COUNTS, TAU_LEAPING
+        } engineType;
                                     // constructor
-        Gillespie_MassAction_Sim( int n, double gamma, double beta) { N=n; GAMMA=gamma; BETA=beta; reset();}
+        Gillespie_MassAction_Sim( int n, double gamma, double beta) {
+            N=n; GAMMA=gamma; BETA=beta;
+            engine=EVENT_QUEUE;
+            tau_epsilon=0.03;
+            critical_infecteds=10;
+            reset();
+        }
 
         int N;                      // population size
         double GAMMA;               // param for exponential recovery time
         double BETA;                // param for exponential transmission time
+        engineType engine;
+        double tau_epsilon;         // TAU_LEAPING: max relative change in propensities per leap
+        int critical_infecteds;     // TAU_LEAPING: take exact steps while I is below this
 
                                     // event queue
-        priority_queue<Event, vector<Event>, compTime > EventQ;
+        priority_queue<MassAction_Event, vector<MassAction_Event>, MassAction_compTime > EventQ;
         vector<int> Compartments;   // S, I, R compartments, with counts for each
         //vector<float> Transmissions;
         double Now;                 // Current "time" in simulation
@@ -48,6 +77,7 @@ class Gillespie_MassAction_Sim {
         mt19937 rng;              // RNG
 
         void run_simulation() {
+            INSTRUMENT_SPAN("Gillespie_MassAction_Sim::run_simulation");
 //            int day = -1;
             while (next_event()) {
 //                if ((int) Now > day) {
@@ -59,6 +89,13 @@ class Gillespie_MassAction_Sim {
             }
         }
 
+        void set_engine(engineType e) { engine = e; }
+
+        void set_tau_leaping_params(double epsilon, int critical) {
+            tau_epsilon = epsilon;
+            critical_infecteds = critical;
+        }
+
         int epidemic_size() {
             return Compartments[2]; // Recovered class
         }
@@ -70,7 +107,7 @@ class Gillespie_MassAction_Sim {
             Compartments.resize(3,0);
             Compartments[0] = N;
             
-            EventQ = priority_queue<Event, vector<Event>, compTime > ();
+            EventQ = priority_queue<MassAction_Event, vector<MassAction_Event>, MassAction_compTime > ();
             //Transmissions.clear();
         }
 
@@ -85,6 +122,7 @@ class Gillespie_MassAction_Sim {
             assert(Compartments[0] > 0);
             Compartments[0]--;      // decrement susceptibles
             Compartments[1]++;      // increment infecteds
+            if (engine != EVENT_QUEUE) return;
                                     // time to recovery
             double Tr = rand_exp(GAMMA, &rng) + Now;
                                     // time to next contact
@@ -104,9 +142,12 @@ class Gillespie_MassAction_Sim {
         }
 
         int next_event() {
+            if (engine == COMPARTMENT_COUNTS) return next_compartment_event();
+            if (engine == TAU_LEAPING) return next_leap();
             if ( EventQ.empty() ) return 0;
-            Event event = EventQ.top(); // get the element
+            MassAction_Event event = EventQ.top(); // get the element
             EventQ.pop();               // remove from Q
+            INSTRUMENT_COUNT("heap pops", 1);
 
             Now = event.time;           // advance time
             if (event.type == 'r') {    // recovery event
@@ -121,8 +162,80 @@ class Gillespie_MassAction_Sim {
             return 1;
         }
 
+        int next_compartment_event() {
+            const double S = Compartments[0];
+            const double I = Compartments[1];
+            if (I == 0) return 0;
+            const double infection_rate = BETA * I * S / (N - 1);
+            const double recovery_rate  = GAMMA * I;
+            const double total = infection_rate + recovery_rate;
+
+            Now += rand_exp(total, &rng);
+            if (rand_uniform(0, total, &rng) < infection_rate) {
+                infect();
+            } else {
+                Compartments[1]--;      // decrement Infected class
+                Compartments[2]++;      // increment Recovered class
+            }
+            return 1;
+        }
+
+        int next_leap() {
+            const int S = Compartments[0];
+            const int I = Compartments[1];
+            if (I == 0) return 0;
+            if (I < critical_infecteds) return next_compartment_event();
+
+            const double infection_rate = BETA * I * S / (N - 1);
+            const double recovery_rate  = GAMMA * I;
+            const double tau = select_tau(S, I, infection_rate, recovery_rate);
+            // a leap this short isn't worth it; Cao et al. suggest 10 events
+            if (tau < 10.0 / (infection_rate + recovery_rate)) return next_compartment_event();
+
+            // Binomial rather than Poisson leaps, so S and I stay non-negative.
+            // Each infected is infectious for (1 - e^-GAMMA*tau)/GAMMA of the leap
+            // on average, not all of it; using that keeps R0 unbiased.
+            // (std::binomial_distribution is O(1) in n*p, unlike rand_binomial.)
+            const double recovery_prob = 1.0 - exp(-GAMMA * tau);
+            const double infectious_time = GAMMA > 0 ? recovery_prob / GAMMA : tau;
+            binomial_distribution<int> infections(S, 1.0 - exp(-BETA * I / (N - 1) * infectious_time));
+            binomial_distribution<int> recoveries(I, recovery_prob);
+            const int new_infections = infections(rng);
+            const int new_recoveries = recoveries(rng);
+
+            Now += tau;
+            Compartments[0] -= new_infections;
+            Compartments[1] += new_infections - new_recoveries;
+            Compartments[2] += new_recoveries;
+            return 1;
+        }
+
+        // Cao, Gillespie & Petzold (2006), eq. 33.  S and I both take part in a
+        // second-order reaction (infection), so g = 2 for each.
+        double select_tau(double S, double I, double infection_rate, double recovery_rate) {
+            const double g = 2.0;
+            const double bound_S = MAX(tau_epsilon * S / g, 1.0);
+            const double bound_I = MAX(tau_epsilon * I / g, 1.0);
+            const double mean_S = infection_rate;                      // |expected change| per unit time
+            const double var_S  = infection_rate;
+            const double mean_I = fabs(infection_rate - recovery_rate);
+            const double var_I  = infection_rate + recovery_rate;
+
+            double tau = numeric_limits<double>::infinity();
+            if (mean_S > 0) tau = MIN(tau, bound_S / mean_S);
+            if (var_S  > 0) tau = MIN(tau, bound_S * bound_S / var_S);
+            if (mean_I > 0) tau = MIN(tau, bound_I / mean_I);
+            if (var_I  > 0) tau = MIN(tau, bound_I * bound_I / var_I);
+            // Near the peak, infections and recoveries cancel and the bounds on I
+            // allow huge leaps, although most of the infecteds are replaced.
+            // Limit the fraction that can recover in one leap too.
+            if (GAMMA > 0) tau = MIN(tau, tau_epsilon / GAMMA);
+            return tau;
+        }
+
         void add_event( double time, char type) {
-            EventQ.push( Event(time,type) );
+            EventQ.push( MassAction_Event(time,type) );
+            INSTRUMENT_COUNT("heap pushes", 1);
             return;
         }
 /*
@@ -10,23 +10,23 @@
 
 using namespace std;
 
-class Event {
+class SEIRS_Event {
     public:
         double time;
         char type;
         Node* node;
-        Event(const Event& o) {  time=o.time; type=o.type; node=o.node; }
-        Event(double t, char e, Node* n) { time=t; type=e; node=n; }
-        Event& operator=(const Event& o) { time=o.time; type=o.type; node=o.node; return *this; }
+        SEIRS_Event(const SEIRS_Event& o) {  time=o.time; type=o.type; node=o.node; }
+        SEIRS_Event(double t, char e, Node* n) { time=t; type=e; node=n; }
+        SEIRS_Event& operator=(const SEIRS_Event& o) { time=o.time; type=o.type; node=o.node; return *this; }
 };
 
-class compTime {
+class SEIRS_compTime {
     public:
-        bool operator() (const Event* lhs, const Event* rhs) const {
+        bool operator() (const SEIRS_Event* lhs, const SEIRS_Event* rhs) const {
             return (lhs->time>rhs->time);
         }
 
-        bool operator() (const Event& lhs, const Event& rhs) const {
+        bool operator() (const SEIRS_Event& lhs, const SEIRS_Event& rhs) const {
             return (lhs.time>rhs.time);
         }
 };
@@ -38,6 +38,16 @@ class Gillespie_Network_SEIRS_Sim {
         typedef enum {
             SUSCEPTIBLE, EXPOSED, INFECTIOUS, RESISTANT, STATE_SIZE // STATE_SIZE must be last
         } stateType;
+
+        // PRESCHEDULED: when a node is infected, all of its contacts are drawn and
+        //     queued at once, so the queue holds ~beta/gamma events per infected node.
+        // NEXT_REACTION: each node only ever has its next event queued.  Because
+        //     contact and recovery are both exponential, an infectious node's next
+        //     event is drawn as the first of the two, and rescheduled when it fires.
+        //     The queue then holds at most one event per non-susceptible node.
+        typedef enum {
+            PRESCHEDULED, NEXT_REACTION
+        } contactModeType;
                                     // constructor
         Gillespie_Network_SEIRS_Sim ( Network* net, double m, double b, double g, double im_dur) {
             network = net;
@@ -45,6 +55,7 @@ class Gillespie_Network_SEIRS_Sim {
             beta = b;
             gamma = g;
             immunity_duration = im_dur; // Immunity duration is fixed (not exponentially distributed)
+            contact_mode = PRESCHEDULED;
             reset();
         }
 
@@ -53,15 +64,17 @@ class Gillespie_Network_SEIRS_Sim {
         double beta;                // param for exponential time to transmission
         double gamma;               // param for exponential time to recovery
         double immunity_duration;   // duration of recovered/resistant state before becoming susceptible
+        contactModeType contact_mode;
 
                                     // event queue
-        priority_queue<Event, vector<Event>, compTime > EventQ;
+        priority_queue<SEIRS_Event, vector<SEIRS_Event>, SEIRS_compTime > EventQ;
         vector<int> state_counts;   // S, E, I, R counts
         double Now;                 // Current "time" in simulation
 
         mt19937 rng;              // RNG
 
         void run_simulation(double duration) {
+            INSTRUMENT_SPAN("Gillespie_Network_SEIRS_Sim::run_simulation");
             double start_time = Now;
             int day = (int) Now;
             while (next_event() and Now < start_time + duration) {
@@ -77,6 +90,8 @@ class Gillespie_Network_SEIRS_Sim {
             }
         }
 
+        void set_contact_mode(contactModeType mode) { contact_mode = mode; }
+
         int current_epidemic_size() {
             return state_counts[EXPOSED] + state_counts[INFECTIOUS];
         }
@@ -91,7 +106,7 @@ class Gillespie_Network_SEIRS_Sim {
             state_counts.resize(STATE_SIZE, 0);
             state_counts[SUSCEPTIBLE] = network->size();
             
-            EventQ = priority_queue<Event, vector<Event>, compTime > ();
+            EventQ = priority_queue<SEIRS_Event, vector<SEIRS_Event>, SEIRS_compTime > ();
         }
 
         // choose n nodes without replacement
@@ -127,6 +142,7 @@ class Gillespie_Network_SEIRS_Sim {
                                     // time to become infectious
             double Ti = rand_exp(mu, &rng) + Now;
             add_event(Ti, 'i', node);
+            if (contact_mode == NEXT_REACTION) return;
                                     // time to recovery
             double Tr = rand_exp(gamma, &rng) + Ti;
                                     // time to next contact
@@ -142,10 +158,18 @@ class Gillespie_Network_SEIRS_Sim {
             return;
         }
 
+        // Queue the next contact or recovery of an infectious node (NEXT_REACTION mode)
+        void add_infectious_event(Node* node) {
+            double T = rand_exp(beta + gamma, &rng) + Now;
+            char type = rand_uniform(0, 1, &rng) * (beta + gamma) < beta ? 'c' : 'r';
+            add_event(T, type, node);
+        }
+
         int next_event() {
             if ( EventQ.empty() ) return 0;
-            Event event = EventQ.top(); // get the element
+            SEIRS_Event event = EventQ.top(); // get the element
             EventQ.pop();               // remove from Q
+            INSTRUMENT_COUNT("heap pops", 1);
 
             Now = event.time;           // advance time
             Node* node = event.node;
@@ -153,10 +177,12 @@ class Gillespie_Network_SEIRS_Sim {
                 node->set_state(INFECTIOUS); 
                 state_counts[EXPOSED]--;      // decrement Infected class
                 state_counts[INFECTIOUS]++;   // increment Recovered class
+                if (contact_mode == NEXT_REACTION) add_infectious_event(node);
             } else if (event.type == 'r') {   // recovery event
                 node->set_state(RESISTANT);
                 state_counts[INFECTIOUS]--;   // decrement Infected class
                 state_counts[RESISTANT]++;    // increment Recovered class
+                if (contact_mode == NEXT_REACTION) add_event(Now + immunity_duration, 's', node);
             } else if (event.type == 's') {   // loss of immunity event
                 node->set_state(SUSCEPTIBLE);
                 state_counts[RESISTANT]--;
@@ -169,6 +195,7 @@ class Gillespie_Network_SEIRS_Sim {
                     Node* contact = neighbors[rand_idx];
                     if ( contact->get_state() == SUSCEPTIBLE ) infect(contact);
                 }
+                if (contact_mode == NEXT_REACTION) add_infectious_event(node);
             } else {
                 cerr << "Unknown event type encountered in simulator: " << event.type << "\nQuitting.\n";
             }
@@ -176,7 +203,8 @@ class Gillespie_Network_SEIRS_Sim {
         }
 
         void add_event( double time, char type, Node* node) {
-            EventQ.push( Event(time,type,node) );
+            EventQ.push( SEIRS_Event(time,type,node) );
+            INSTRUMENT_COUNT("heap pushes", 1);
             return;
         }
 
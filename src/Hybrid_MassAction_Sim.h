@@ -0,0 +1,82 @@
+#ifndef HYBRID_MASSACTION_SIM_H
+#define HYBRID_MASSACTION_SIM_H
+
+#include "Gillespie_MassAction_Sim.h"
+#include "SIR_Sim.h"
+
+using namespace std;
+
+/******************************************************************************
+ * Gillespie_MassAction_Sim that hands off to the SIR differential equations
+ * while the epidemic is large.  Once ode_above individuals are infected, the
+ * counts are integrated deterministically (DiffEq_Sim, with beta scaled to
+ * counts) until fewer than ssa_below remain infected; the counts are then
+ * rounded and the exact (or tau-leaping) engine takes over again.  Early
+ * stochastic die-out and the final approach to extinction are therefore
+ * still simulated exactly, but the bulk of the epidemic costs a few hundred
+ * ODE steps instead of ~2N events.
+ *
+ * The stochastic part must use COMPARTMENT_COUNTS (default) or TAU_LEAPING;
+ * an event queue can't be reconstructed from rounded counts.  GAMMA must be
+ * positive: without recovery the ODE would never bring the infecteds back
+ * below ssa_below, and never return.
+ *****************************************************************************/
+
+class Hybrid_MassAction_Sim : public Gillespie_MassAction_Sim {
+    public:
+        Hybrid_MassAction_Sim( int n, double gamma, double beta, int ode_above = 1000, int ssa_below = 100) :
+            Gillespie_MassAction_Sim(n, gamma, beta) {
+            assert(gamma > 0);
+            engine = COMPARTMENT_COUNTS;
+            set_thresholds(ode_above, ssa_below);
+            ode_time = 0.0;
+        }
+
+        int ode_threshold;          // switch to the ODE at or above this many infecteds
+        int ssa_threshold;          // ... and back to the stochastic engine below this many
+        double ode_time;            // total simulated time spent in the ODE
+        SIR ode;
+
+        void set_thresholds(int ode_above, int ssa_below) {
+            assert(ssa_below > 0 and ssa_below <= ode_above);
+            ode_threshold = ode_above;
+            ssa_threshold = ssa_below;
+        }
+
+        void run_simulation() {
+            while (next_event()) continue;
+        }
+
+        void reset() {
+            Gillespie_MassAction_Sim::reset();
+            ode_time = 0.0;
+        }
+
+        int next_event() {
+            assert(engine != EVENT_QUEUE);
+            if (Compartments[1] >= ode_threshold) {
+                run_ode();
+                return 1;
+            }
+            return Gillespie_MassAction_Sim::next_event();
+        }
+
+        // Integrate until fewer than ssa_threshold are infected.  Steps are a
+        // tenth of the mean infectious period, so I changes by ~10% at most
+        // between checks.
+        void run_ode() {
+            assert(GAMMA > 0);
+            ode.set_parameters(BETA / (N - 1), GAMMA);
+            ode.initialize(Compartments[0], Compartments[1], Compartments[2]);
+            const double step = 0.1 / GAMMA;
+            while (ode.y[1] >= ssa_threshold) ode.step_simulation(step);
+
+            Now += ode.get_time();
+            ode_time += ode.get_time();
+            Compartments[0] = (int) (ode.y[0] + 0.5);
+            Compartments[1] = MIN((int) (ode.y[1] + 0.5), N - Compartments[0]);
+            Compartments[2] = N - Compartments[0] - Compartments[1];
+        }
+};
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+/******************************************************************************
+ * Timing spans and event counters for finding out where a run spends its time.
+ * All of it is compiled in only when EPIFIRE_INSTRUMENT is defined, which
+ * the makefiles in src/ and examples/ do when INSTRUMENT is set:
+ *
+ *      make clean; make INSTRUMENT=1
+ *
+ * Otherwise the macros below expand to nothing and this header includes
+ * nothing, so there is no cost at all.
+ *
+ *      INSTRUMENT_SPAN("name");        // times the rest of the enclosing scope
+ *      INSTRUMENT_COUNT("name", n);    // adds n to a named counter
+ *
+ * Names must be string literals.  Each thread keeps its own totals and its own
+ * log of spans, so recording one costs two clock reads and taking the log's
+ * lock, which only the report ever contends for; only the first MAX_EVENTS
+ * spans per thread are logged individually, but all of them are counted.
+ * Peak resident memory is sampled whenever a thread's outermost span ends.
+ *
+ * Timings taken with instrumentation on include that locking, for every span
+ * and every INSTRUMENT_COUNT, among them the counters bumped on each random
+ * number draw.  Benchmark numbers from an INSTRUMENT=1 build are therefore
+ * not comparable with those from an uninstrumented one.
+ *
+ * At exit, a report is written to the file named by the EPIFIRE_TRACE
+ * environment variable (epifire_trace.json by default).  It is in Chrome's
+ * trace event format, so it can be opened in chrome://tracing or Perfetto, and
+ * its "otherData" section has the call count and total time of every span, the
+ * counter totals and the peak resident memory.  write_report() writes the same
+ * report on demand.
+ *****************************************************************************/
+
+#ifdef EPIFIRE_INSTRUMENT
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+namespace instrument {
+
+    using std::vector;
+
+    const size_t MAX_EVENTS = 1 << 20;  // per thread
+
+    // a span, or for site == -1 a memory sample: peak RSS (kB) in start, and
+    // the time it was taken in duration
+    struct Event {
+        int site;
+        long long start;            // ns since the first site was registered
+        long long duration;         // ns
+    };
+
+    // Only its own thread writes to a log, always holding lock, so that the
+    // report can take a consistent copy while the thread is still running
+    struct ThreadLog {
+        std::mutex lock;
+        int tid;
+        int depth;
+        vector<Event> events;
+        vector<long long> calls;    // by span
+        vector<long long> time;     // by span, ns
+        vector<long long> counts;   // by counter
+    };
+
+    struct Registry {
+        std::mutex lock;
+        vector<const char*> spans;
+        vector<const char*> counters;
+        vector< std::unique_ptr<ThreadLog> > logs;
+        std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    };
+
+    inline void write_report(const char* filename);
+
+    inline Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    inline void write_report_at_exit() {
+        const char* filename = getenv("EPIFIRE_TRACE");
+        write_report(filename ? filename : "epifire_trace.json");
+    }
+
+    inline int _register(vector<const char*>& names, const char* name) {
+        static std::once_flag at_exit;
+        std::call_once(at_exit, []() { registry(); atexit(write_report_at_exit); });
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        for (unsigned int i = 0; i < names.size(); i++) if (strcmp(names[i], name) == 0) return i;
+        names.push_back(name);
+        return names.size() - 1;
+    }
+
+    inline int span_site(const char* name) { return _register(registry().spans, name); }
+    inline int counter_site(const char* name) { return _register(registry().counters, name); }
+
+    inline ThreadLog& thread_log() {
+        static thread_local ThreadLog* log = NULL;
+        if (not log) {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> guard(r.lock);
+            log = new ThreadLog();
+            log->tid = r.logs.size();
+            log->depth = 0;
+            r.logs.emplace_back(log);
+        }
+        return *log;
+    }
+
+    inline long long now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().origin).count();
+    }
+
+    inline long peak_rss_kb() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;     // kB on Linux
+    }
+
+    inline void count(int counter, long long n) {
+        ThreadLog& log = thread_log();
+        std::lock_guard<std::mutex> guard(log.lock);
+        if ((unsigned) counter >= log.counts.size()) log.counts.resize(counter + 1, 0);
+        log.counts[counter] += n;
+    }
+
+    class Span {
+        public:
+            Span(int site) : site(site), log(thread_log()) {
+                log.depth++;
+                start = now();
+            }
+
+            ~Span() {
+                const long long duration = now() - start;
+                const bool outermost = --log.depth == 0;
+                const long peak = outermost ? peak_rss_kb() : 0;
+                std::lock_guard<std::mutex> guard(log.lock);
+                if ((unsigned) site >= log.calls.size()) {
+                    log.calls.resize(site + 1, 0);
+                    log.time.resize(site + 1, 0);
+                }
+                log.calls[site]++;
+                log.time[site] += duration;
+                if (log.events.size() < MAX_EVENTS) log.events.push_back({site, start, duration});
+                if (outermost and log.events.size() < MAX_EVENTS) {
+                    log.events.push_back({-1, peak, start + duration});
+                }
+            }
+
+        private:
+            int site;
+            ThreadLog& log;
+            long long start;
+    };
+
+    inline std::string quoted(const char* s) {
+        std::string q = "\"";
+        for (; *s; s++) {
+            if (*s == '"' or *s == '\\') q += '\\';
+            q += *s;
+        }
+        return q + "\"";
+    }
+
+    // Threads that are still running may be part way through a span; only
+    // what they have finished is reported.  Each thread's log is copied under
+    // its lock, so a thread is only held up for the copy, not the writing.
+    inline void write_report(const char* filename) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        FILE* out = fopen(filename, "w");
+        if (not out) {
+            fprintf(stderr, "Could not write instrumentation report to %s\n", filename);
+            return;
+        }
+
+        vector<long long> calls(r.spans.size()), time(r.spans.size()), counts(r.counters.size());
+        fprintf(out, "{\"traceEvents\":[\n");
+        bool first = true;
+        for (unsigned int t = 0; t < r.logs.size(); t++) {
+            ThreadLog log;
+            {
+                ThreadLog& live = *r.logs[t];
+                std::lock_guard<std::mutex> log_guard(live.lock);
+                log.tid = live.tid;
+                log.events = live.events;
+                log.calls = live.calls;
+                log.time = live.time;
+                log.counts = live.counts;
+            }
+            for (unsigned int i = 0; i < log.calls.size(); i++) { calls[i] += log.calls[i]; time[i] += log.time[i]; }
+            for (unsigned int i = 0; i < log.counts.size(); i++) counts[i] += log.counts[i];
+            for (unsigned int i = 0; i < log.events.size(); i++) {
+                const Event& e = log.events[i];
+                if (not first) fprintf(out, ",\n");
+                first = false;
+                if (e.site < 0) {
+                    fprintf(out, "{\"name\":\"peak RSS\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"MB\":%.1f}}",
+                            log.tid, e.duration * 1e-3, e.start / 1024.0);
+                } else {
+                    fprintf(out, "{\"name\":%s,\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                            quoted(r.spans[e.site]).c_str(), log.tid, e.start * 1e-3, e.duration * 1e-3);
+                }
+            }
+        }
+        fprintf(out, "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\n\"spans\":{");
+        for (unsigned int i = 0; i < r.spans.size(); i++) {
+            fprintf(out, "%s\n  %s:{\"calls\":%lld,\"total_ms\":%.3f}", i ? "," : "", quoted(r.spans[i]).c_str(), calls[i], time[i] * 1e-6);
+        }
+        fprintf(out, "},\n\"counters\":{");
+        for (unsigned int i = 0; i < r.counters.size(); i++) {
+            fprintf(out, "%s\n  %s:%lld", i ? "," : "", quoted(r.counters[i]).c_str(), counts[i]);
+        }
+        fprintf(out, "},\n\"peak_rss_kb\":%ld\n}}\n", peak_rss_kb());
+        fclose(out);
+    }
+}
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+#define INSTRUMENT_SPAN(name) \
+    static const int INSTRUMENT_CONCAT(_instrument_site_, __LINE__) = instrument::span_site(name); \
+    instrument::Span INSTRUMENT_CONCAT(_instrument_span_, __LINE__)(INSTRUMENT_CONCAT(_instrument_site_, __LINE__))
+#define INSTRUMENT_COUNT(name, n) \
+    do { static const int _instrument_counter = instrument::counter_site(name); instrument::count(_instrument_counter, n); } while (0)
+
+#else
+
+#define INSTRUMENT_SPAN(name)
+#define INSTRUMENT_COUNT(name, n) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,454 @@
+#ifndef LOUVAIN_H
+#define LOUVAIN_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdint.h>
+#include "Network.h"
+#include "Adjacency.h"
+#include "Utility.h"
+
+using namespace std;
+
+/******************************************************************************
+ * Community detection by the Louvain method (Blondel et al. 2008): nodes are
+ * moved between communities while that increases modularity, then each
+ * community is collapsed into one node and the process repeats on the
+ * smaller network, until nothing changes.
+ *
+ *      Louvain louvain(&my_network, true);  // true: edge costs are weights
+ *      louvain.run();
+ *      int c = louvain.get_labels()[i];     // community of get_nodes()[i]
+ *      double Q = louvain.get_modularity();
+ *
+ * Labels are dense (0 .. num_communities()-1), numbered in order of first
+ * appearance among the nodes.  Directed networks are treated as undirected,
+ * with the weights of i->j and j->i added together.  Weights (edge costs, if
+ * used) should be positive.
+ *
+ * The work is done on a compact CSR copy of the topology (from an Adjacency
+ * snapshot; unweighted edges take no space for weights), so a network of 10^7
+ * nodes needs little more than its edge list.  Moves are parallelized as in
+ * Lu, Halappanavar & Kalyanaraman (2015): the nodes are colored so that no two
+ * neighbors share a color, and the nodes of one color find their best moves
+ * in parallel.  Their neighbors' communities can't change meanwhile, so this
+ * behaves much like moving nodes one at a time; only the community totals are
+ * as of the start of the color.  The moves are then applied in node order.
+ * The coloring is greedy, in node order, so the result doesn't depend on the
+ * number of threads.  Collapsing communities is also done in parallel.
+ *****************************************************************************/
+
+class Louvain {
+    public:
+        static const int CHUNK_SIZE = 4096;
+
+        Louvain(Network* net, bool use_costs = false, int num_threads = 0) {
+            Adjacency adj(net);
+            init(adj, net->is_directed(), use_costs, num_threads);
+        }
+
+        Louvain(const Adjacency& adj, bool directed, bool use_costs = false, int num_threads = 0) {
+            init(adj, directed, use_costs, num_threads);
+        }
+
+        void set_num_threads(int n) { threads = MAX(1, n); }
+
+        // a pass over the nodes (or a level) has to raise modularity by at least
+        // this much for another to be done
+        void set_tolerance(double tol) { tolerance = tol; }
+
+        // returns the modularity of the communities found
+        double run() {
+            labels.resize(base.size());
+            for (int i = 0; i < base.size(); i++) labels[i] = i;
+            level_modularity.clear();
+            modularity = 0;
+            communities = base.size();
+            if (base.total <= 0) return modularity; // no edges: every node on its own
+
+            Graph coarse;
+            const Graph* g = &base;
+            while (true) {
+                vector<int> comm;
+                const double Q = move_nodes(*g, comm);
+                vector<int> new_id;
+                const int C = renumber(comm, new_id);
+                for (unsigned int v = 0; v < labels.size(); v++) labels[v] = new_id[ comm[ labels[v] ] ];
+
+                const bool improved = level_modularity.empty() or Q - level_modularity.back() > tolerance;
+                level_modularity.push_back(Q);
+                modularity = Q;
+                if (C == g->size() or not improved) break;
+                Graph next = collapse(*g, comm, new_id, C);
+                coarse.offsets.swap(next.offsets);
+                coarse.targets.swap(next.targets);
+                coarse.weights.swap(next.weights);
+                coarse.strength.swap(next.strength);
+                coarse.total = next.total;
+                g = &coarse;
+            }
+
+            // number communities by first appearance
+            vector<int> first(labels.size(), -1);
+            int next = 0;
+            for (unsigned int v = 0; v < labels.size(); v++) {
+                if (first[ labels[v] ] < 0) first[ labels[v] ] = next++;
+                labels[v] = first[ labels[v] ];
+            }
+            communities = next;
+            return modularity;
+        }
+
+        const vector<int>& get_labels() const { return labels; }
+        int num_communities() const { return communities; }
+        double get_modularity() const { return modularity; }
+        int num_levels() const { return level_modularity.size(); }
+        const vector<double>& get_level_modularity() const { return level_modularity; }
+
+        vector< vector<Node*> > get_communities() const {
+            vector< vector<Node*> > members(communities);
+            for (unsigned int v = 0; v < labels.size(); v++) members[ labels[v] ].push_back(nodes[v]);
+            return members;
+        }
+
+    private:
+        // Undirected weighted graph; each edge appears in the rows of both ends
+        class Graph {
+            public:
+                vector<int> offsets;
+                vector<int> targets;
+                vector<double> weights;     // (empty if every weight is 1)
+                vector<double> strength;    // row sums
+                double total;               // sum of all strengths
+
+                int size() const { return offsets.size() - 1; }
+                inline double weight(int e) const { return weights.empty() ? 1.0 : weights[e]; }
+        };
+
+        // Sums edge weights by community for one node at a time
+        class Community_Weights {
+            public:
+                vector<int> used;           // slots in use, in order of first use
+
+                void reset(int capacity) {
+                    for (unsigned int k = 0; k < used.size(); k++) keys[ used[k] ] = -1;
+                    used.clear();
+                    bits = 4;
+                    while ((1 << bits) < 2 * capacity) bits++;
+                    if (keys.size() < (size_t) 1 << bits) {
+                        keys.assign((size_t) 1 << bits, -1);
+                        vals.resize((size_t) 1 << bits);
+                    }
+                    mask = (1 << bits) - 1;
+                }
+
+                inline void add(int c, double w) {
+                    int s = slot(c);
+                    if (keys[s] < 0) { keys[s] = c; vals[s] = 0.0; used.push_back(s); }
+                    vals[s] += w;
+                }
+
+                inline double get(int c) const { int s = slot(c); return keys[s] < 0 ? 0.0 : vals[s]; }
+                inline int key(int k) const { return keys[ used[k] ]; }
+                inline double value(int k) const { return vals[ used[k] ]; }
+
+            private:
+                vector<int> keys;
+                vector<double> vals;
+                int bits, mask;
+
+                inline int slot(int c) const {
+                    int s = (int) (((uint64_t) c * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+                    while (keys[s] >= 0 and keys[s] != c) s = (s + 1) & mask;
+                    return s;
+                }
+        };
+
+        class Barrier {
+            public:
+                Barrier(int n) : count(n), waiting(0), generation(0) {}
+                void wait() {
+                    if (count == 1) return;
+                    unique_lock<mutex> lock(m);
+                    const int gen = generation;
+                    if (++waiting == count) {
+                        waiting = 0;
+                        generation++;
+                        cv.notify_all();
+                    } else {
+                        cv.wait(lock, [&] { return gen != generation; });
+                    }
+                }
+            private:
+                mutex m;
+                condition_variable cv;
+                int count, waiting, generation;
+        };
+
+        Graph base;
+        vector<Node*> nodes;
+        int threads;
+        double tolerance;
+        vector<int> labels;
+        int communities;
+        double modularity;
+        vector<double> level_modularity;
+
+        void init(const Adjacency& adj, bool directed, bool use_costs, int num_threads) {
+            nodes = adj.nodes;
+            threads = num_threads > 0 ? num_threads : MAX(1, (int) thread::hardware_concurrency());
+            tolerance = 1e-6;
+            communities = 0;
+            modularity = 0;
+
+            const int n = adj.size();
+            Graph& g = base;
+            if (not directed) {
+                g.offsets = adj.offsets;
+                g.targets = adj.neighbors;
+                if (use_costs) g.weights = adj.costs;
+            } else {
+                // add each edge to the row of its other end as well
+                g.offsets.assign(n + 1, 0);
+                for (int i = 0; i < n; i++) {
+                    g.offsets[i+1] += adj.deg(i);
+                    for (int e = adj.begin(i); e < adj.end(i); e++) g.offsets[ adj.neighbors[e] + 1 ]++;
+                }
+                for (int i = 0; i < n; i++) g.offsets[i+1] += g.offsets[i];
+                g.targets.resize(g.offsets[n]);
+                if (use_costs) g.weights.resize(g.offsets[n]);
+                vector<int> fill(g.offsets.begin(), g.offsets.end() - 1);
+                for (int i = 0; i < n; i++) {
+                    for (int e = adj.begin(i); e < adj.end(i); e++) {
+                        const int j = adj.neighbors[e];
+                        if (use_costs) { g.weights[ fill[i] ] = adj.costs[e]; g.weights[ fill[j] ] = adj.costs[e]; }
+                        g.targets[ fill[i]++ ] = j;
+                        g.targets[ fill[j]++ ] = i;
+                    }
+                }
+            }
+            set_strengths(g);
+        }
+
+        static void set_strengths(Graph& g) {
+            g.strength.assign(g.size(), 0.0);
+            g.total = 0;
+            for (int i = 0; i < g.size(); i++) {
+                for (int e = g.offsets[i]; e < g.offsets[i+1]; e++) g.strength[i] += g.weight(e);
+                g.total += g.strength[i];
+            }
+        }
+
+        // Runs fn(t) for t = 0 .. threads-1, each on its own thread
+        void run_threads(int n, function<void (int)> fn) {
+            if (n == 1) { fn(0); return; }
+            vector<thread> pool;
+            for (int t = 0; t < n; t++) pool.push_back( thread(fn, t) );
+            for (int t = 0; t < n; t++) pool[t].join();
+        }
+
+        static inline void split(int lo, int hi, int t, int n, int& begin, int& end) {
+            const long len = hi - lo;
+            begin = lo + (int) (len * t / n);
+            end   = lo + (int) (len * (t + 1) / n);
+        }
+
+        // The weight inside communities is summed over blocks of CHUNK_SIZE nodes,
+        // and the blocks are added up in order, so that Q (and so the decision
+        // to stop) doesn't depend on the number of threads
+        double compute_modularity(const Graph& g, const vector<int>& comm, const vector<double>& tot, int n_threads) {
+            const int n_blocks = (g.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            vector<double> inside(n_blocks, 0.0);
+            run_threads(n_threads, [&](int t) {
+                for (int b = t; b < n_blocks; b += n_threads) {
+                    const int end = MIN(g.size(), (b + 1) * CHUNK_SIZE);
+                    double sum = 0;
+                    for (int i = b * CHUNK_SIZE; i < end; i++) {
+                        for (int e = g.offsets[i]; e < g.offsets[i+1]; e++) {
+                            if (comm[ g.targets[e] ] == comm[i]) sum += g.weight(e);
+                        }
+                    }
+                    inside[b] = sum;
+                }
+            });
+            double Q = 0;
+            for (int b = 0; b < n_blocks; b++) Q += inside[b];
+            Q /= g.total;
+            for (unsigned int c = 0; c < tot.size(); c++) Q -= (tot[c] / g.total) * (tot[c] / g.total);
+            return Q;
+        }
+
+        // The community that node i should move to, given comm and tot
+        int best_community(const Graph& g, int i, const vector<int>& comm, const vector<double>& tot,
+                           Community_Weights& cw) {
+            const int a = comm[i];
+            const double ki = g.strength[i];
+            cw.reset(g.offsets[i+1] - g.offsets[i] + 1);
+            cw.add(a, 0.0);
+            for (int e = g.offsets[i]; e < g.offsets[i+1]; e++) {
+                const int j = g.targets[e];
+                if (j != i) cw.add(comm[j], g.weight(e));
+            }
+
+            // gain from joining community c (scaled by total weight / 2)
+            int best = a;
+            double best_gain = cw.get(a) - ki * (tot[a] - ki) / g.total;
+            for (unsigned int k = 0; k < cw.used.size(); k++) {
+                const int c = cw.key(k);
+                if (c == a) continue;
+                const double gain = cw.value(k) - ki * tot[c] / g.total;
+                if (gain > best_gain or (gain == best_gain and best != a and c < best)) {
+                    best = c;
+                    best_gain = gain;
+                }
+            }
+            return best;
+        }
+
+        // Greedy coloring, in node order; nodes of color k are
+        // order[ color_offsets[k] ] .. order[ color_offsets[k+1] - 1 ]
+        void color_nodes(const Graph& g, vector<int>& order, vector<int>& color_offsets) {
+            const int n = g.size();
+            vector<int> color(n, -1), seen;     // seen[k] == i: color k is taken by a neighbor of i
+            int num_colors = 0;
+            for (int i = 0; i < n; i++) {
+                for (int e = g.offsets[i]; e < g.offsets[i+1]; e++) {
+                    const int c = color[ g.targets[e] ];
+                    if (c >= 0) seen[c] = i;
+                }
+                int c = 0;
+                while (c < num_colors and seen[c] == i) c++;
+                if (c == num_colors) { num_colors++; seen.push_back(-1); }
+                color[i] = c;
+            }
+            color_offsets.assign(num_colors + 1, 0);
+            for (int i = 0; i < n; i++) color_offsets[ color[i] + 1 ]++;
+            for (int c = 0; c < num_colors; c++) color_offsets[c+1] += color_offsets[c];
+            vector<int> fill(color_offsets.begin(), color_offsets.end() - 1);
+            order.resize(n);
+            for (int i = 0; i < n; i++) order[ fill[ color[i] ]++ ] = i;
+        }
+
+        // Local moving phase; returns the modularity of the communities in comm
+        double move_nodes(const Graph& g, vector<int>& comm) {
+            const int n = g.size();
+            comm.resize(n);
+            vector<double> tot(g.strength);
+            for (int i = 0; i < n; i++) comm[i] = i;
+
+            vector<int> order, color_offsets;
+            color_nodes(g, order, color_offsets);
+
+            const int n_threads = MAX(1, MIN(threads, n / 1000));
+            vector<int> proposal(n);
+            vector<char> active(n, 1), next_active(n, 0);
+            vector<Community_Weights> cw(n_threads);
+            double Q = compute_modularity(g, comm, tot, n_threads);
+            vector<int> last_comm;
+            vector<double> last_tot;
+
+            while (true) {
+                last_comm = comm; last_tot = tot;
+                Barrier barrier(n_threads);
+                run_threads(n_threads, [&](int t) {
+                    for (unsigned int k = 0; k + 1 < color_offsets.size(); k++)
+                    for (int chunk = color_offsets[k]; chunk < color_offsets[k+1]; chunk += CHUNK_SIZE) {
+                        const int chunk_end = MIN(chunk + CHUNK_SIZE, color_offsets[k+1]);
+                        int begin, end;
+                        split(chunk, chunk_end, t, n_threads, begin, end);
+                        for (int x = begin; x < end; x++) {
+                            const int i = order[x];
+                            proposal[x] = active[i] ? best_community(g, i, comm, tot, cw[t]) : comm[i];
+                        }
+                        barrier.wait();
+                        if (t == 0) {
+                            for (int x = chunk; x < chunk_end; x++) {
+                                const int i = order[x], a = comm[i], c = proposal[x];
+                                if (a == c) continue;
+                                tot[a] -= g.strength[i];
+                                tot[c] += g.strength[i];
+                                comm[i] = c;
+                                for (int e = g.offsets[i]; e < g.offsets[i+1]; e++) next_active[ g.targets[e] ] = 1;
+                            }
+                        }
+                        barrier.wait();
+                    }
+                });
+
+                active.swap(next_active);
+                next_active.assign(n, 0);
+                const double new_Q = compute_modularity(g, comm, tot, n_threads);
+                if (new_Q < Q) {    // moves made together can (rarely) make things worse
+                    comm.swap(last_comm); tot.swap(last_tot);
+                    break;
+                }
+                const bool done = new_Q - Q <= tolerance;
+                Q = new_Q;
+                if (done) break;
+            }
+            return Q;
+        }
+
+        // Dense numbering of the communities in use, in order of first appearance
+        int renumber(const vector<int>& comm, vector<int>& new_id) {
+            new_id.assign(comm.size(), -1);
+            int C = 0;
+            for (unsigned int i = 0; i < comm.size(); i++) {
+                if (new_id[ comm[i] ] < 0) new_id[ comm[i] ] = C++;
+            }
+            return C;
+        }
+
+        // One node per community; edges within a community become a self-loop
+        Graph collapse(const Graph& g, const vector<int>& comm, const vector<int>& new_id, int C) {
+            const int n = g.size();
+            vector<int> member_offsets(C + 1, 0), members(n);
+            for (int i = 0; i < n; i++) member_offsets[ new_id[ comm[i] ] + 1 ]++;
+            for (int c = 0; c < C; c++) member_offsets[c+1] += member_offsets[c];
+            vector<int> fill(member_offsets.begin(), member_offsets.end() - 1);
+            for (int i = 0; i < n; i++) members[ fill[ new_id[ comm[i] ] ]++ ] = i;
+
+            const int n_threads = MAX(1, MIN(threads, C / 1000));
+            vector< vector<int> > part_targets(n_threads);
+            vector< vector<double> > part_weights(n_threads);
+            vector<int> row_len(C);
+            run_threads(n_threads, [&](int t) {
+                Community_Weights cw;
+                int begin, end;
+                split(0, C, t, n_threads, begin, end);
+                for (int c = begin; c < end; c++) {
+                    int edges = 0;
+                    for (int m = member_offsets[c]; m < member_offsets[c+1]; m++) {
+                        edges += g.offsets[ members[m] + 1 ] - g.offsets[ members[m] ];
+                    }
+                    cw.reset(MIN(edges, C) + 1);
+                    for (int m = member_offsets[c]; m < member_offsets[c+1]; m++) {
+                        const int i = members[m];
+                        for (int e = g.offsets[i]; e < g.offsets[i+1]; e++) cw.add(new_id[ comm[ g.targets[e] ] ], g.weight(e));
+                    }
+                    row_len[c] = cw.used.size();
+                    for (unsigned int k = 0; k < cw.used.size(); k++) {
+                        part_targets[t].push_back(cw.key(k));
+                        part_weights[t].push_back(cw.value(k));
+                    }
+                }
+            });
+
+            Graph coarse;
+            coarse.offsets.assign(C + 1, 0);
+            for (int c = 0; c < C; c++) coarse.offsets[c+1] = coarse.offsets[c] + row_len[c];
+            coarse.targets.reserve(coarse.offsets[C]);
+            coarse.weights.reserve(coarse.offsets[C]);
+            for (int t = 0; t < n_threads; t++) {
+                coarse.targets.insert(coarse.targets.end(), part_targets[t].begin(), part_targets[t].end());
+                coarse.weights.insert(coarse.weights.end(), part_weights[t].begin(), part_weights[t].end());
+            }
+            set_strengths(coarse);
+            return coarse;
+        }
+};
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef METAPOPULATION_SEIR_SIM_H
+#define METAPOPULATION_SEIR_SIM_H
+
+#include <gsl/gsl_odeiv.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_cblas.h>
+#include <iostream>
+#include <vector>
+#include <assert.h>
+#include "DiffEq_Sim.h"
+
+using namespace std;
+
+/******************************************************************************
+ * SEIR equations for a population divided into patches (e.g. counties), each
+ * divided into the same set of groups (e.g. age classes).  Group a in patch p
+ * is infected at rate
+ *
+ *      lambda[p,a] = beta * sum_q M[p,q] * sum_b C[a,b] * I[q,b] / N[q,b]
+ *
+ * where C is the contact matrix between groups, and M is the mobility (or
+ * coupling) matrix between patches: M[p,q] is how much of p's exposure happens
+ * in q.  Without a mobility matrix, patches are independent (M = identity),
+ * and with one group, C = 1 unless set.  Then
+ *
+ *      dS/dt = -lambda S,  dE/dt = lambda S - sigma E,
+ *      dI/dt = sigma E - gamma I,  dR/dt = gamma I
+ *
+ * in numbers of people.  The force of infection is the expensive part, and is
+ * done with the CBLAS routines from gsl_subset: the contact step is a
+ * matrix-matrix product over all patches at once (dgemm), or a matrix-vector
+ * product (dgemv, or dsymv if C is symmetric) if there is only one patch; the
+ * mobility step is likewise dgemm, or dgemv/dsymv with one group.  A sparse
+ * mobility matrix can be given in compressed sparse row (CSR) form instead, in
+ * which case that step costs O(nonzeros * groups).  Linking against an
+ * optimized CBLAS in place of gsl_subset's speeds up the dense cases without
+ * any change here.
+ *
+ * y is laid out by compartment (S, E, I, R), and within each compartment by
+ * patch and then group: index p * num_groups + a.
+ *****************************************************************************/
+
+class Metapopulation_SEIR_Sim : public DiffEq_Sim {
+    public:
+        Metapopulation_SEIR_Sim(int patches, int groups, double b, double s, double g) {
+            P = patches;
+            A = groups;
+            nbins = 4 * P * A;
+            set_parameters(b, s, g);
+            contact.assign(A * A, 0.0);
+            for (int a = 0; a < A; a++) contact[a * A + a] = 1.0;
+            contact_symmetric = true;
+            mobility_mode = NO_MOBILITY;
+            mobility_symmetric = false;
+            inv_N.assign(P * A, 0.0);
+            prevalence.assign(P * A, 0.0);
+            mixed.assign(P * A, 0.0);
+            lambda.assign(P * A, 0.0);
+        }
+
+        ~Metapopulation_SEIR_Sim() {};
+
+        // for reusing one instance across parameter values; follow with initialize()
+        void set_parameters(double b, double s, double g) {
+            beta = b;
+            sigma = s;
+            gamma = g;
+        }
+
+        // num_groups x num_groups, row-major
+        void set_contact_matrix(const vector<double>& C, bool symmetric = false) {
+            assert(C.size() == (size_t) A * A);
+            contact = C;
+            contact_symmetric = symmetric;
+        }
+
+        // num_patches x num_patches, row-major
+        void set_mobility_matrix(const vector<double>& M, bool symmetric = false) {
+            assert(M.size() == (size_t) P * P);
+            mobility = M;
+            mobility_symmetric = symmetric;
+            mobility_mode = DENSE_MOBILITY;
+        }
+
+        // sparse: the nonzeros of row p are values[row_offsets[p] .. row_offsets[p+1]-1],
+        // in columns cols[...]
+        void set_mobility_matrix(const vector<int>& row_offsets, const vector<int>& cols, const vector<double>& values) {
+            assert(row_offsets.size() == (size_t) P + 1);
+            assert(cols.size() == values.size() and (int) cols.size() == row_offsets.back());
+            mob_offsets = row_offsets;
+            mob_cols = cols;
+            mob_values = values;
+            mobility_mode = SPARSE_MOBILITY;
+        }
+
+        // Population sizes, by patch and then group.  All start out susceptible;
+        // follow with infect().
+        void initialize(const vector<double>& N) {
+            assert(N.size() == (size_t) P * A);
+            init_state();
+            for (int x = 0; x < P * A; x++) {
+                y[x] = N[x];
+                inv_N[x] = N[x] > 0 ? 1.0 / N[x] : 0.0;
+            }
+        }
+
+        // move n people from S to I
+        void infect(int patch, int group, double n) {
+            const int x = patch * A + group;
+            assert(n <= y[x]);
+            y[x] -= n;
+            y[2*P*A + x] += n;
+        }
+
+        int num_patches() { return P; }
+        int num_groups() { return A; }
+
+        double susceptible(int p, int a) { return y[p*A + a]; }
+        double exposed(int p, int a)     { return y[P*A + p*A + a]; }
+        double infectious(int p, int a)  { return y[2*P*A + p*A + a]; }
+        double recovered(int p, int a)   { return y[3*P*A + p*A + a]; }
+
+        double current_susceptible() { return total(0); }
+        double current_exposed()     { return total(1); }
+        double current_infectious()  { return total(2); }
+        double current_recovered()   { return total(3); }
+
+        // lambda from the last derivative() call
+        const vector<double>& force_of_infection() { return lambda; }
+
+        void derivative(double const y[], double dydt[]) {
+            const int n = P * A;
+            const double* S = y;
+            const double* E = y + n;
+            const double* I = y + 2*n;
+            for (int x = 0; x < n; x++) prevalence[x] = I[x] * inv_N[x];
+
+            // mixed[p,a] = sum_b C[a,b] prevalence[p,b]
+            if (A == 1) {
+                for (int p = 0; p < P; p++) mixed[p] = contact[0] * prevalence[p];
+            } else if (P == 1) {
+                matrix_vector(contact, contact_symmetric, A, 1.0, &prevalence[0], &mixed[0]);
+            } else {
+                cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, P, A, A,
+                            1.0, &prevalence[0], A, &contact[0], A, 0.0, &mixed[0], A);
+            }
+
+            // lambda[p,a] = beta sum_q M[p,q] mixed[q,a]
+            if (mobility_mode == NO_MOBILITY) {
+                for (int x = 0; x < n; x++) lambda[x] = beta * mixed[x];
+            } else if (mobility_mode == DENSE_MOBILITY) {
+                if (A == 1) {
+                    matrix_vector(mobility, mobility_symmetric, P, beta, &mixed[0], &lambda[0]);
+                } else {
+                    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, P, A, P,
+                                beta, &mobility[0], P, &mixed[0], A, 0.0, &lambda[0], A);
+                }
+            } else {
+                for (int p = 0; p < P; p++) {
+                    double* l = &lambda[p * A];
+                    for (int a = 0; a < A; a++) l[a] = 0.0;
+                    for (int e = mob_offsets[p]; e < mob_offsets[p+1]; e++) {
+                        const double m = beta * mob_values[e];
+                        const double* src = &mixed[ mob_cols[e] * A ];
+                        for (int a = 0; a < A; a++) l[a] += m * src[a];
+                    }
+                }
+            }
+
+            double* dS = dydt;
+            double* dE = dydt + n;
+            double* dI = dydt + 2*n;
+            double* dR = dydt + 3*n;
+            for (int x = 0; x < n; x++) {
+                const double infection = lambda[x] * S[x];
+                const double onset     = sigma * E[x];
+                const double recovery  = gamma * I[x];
+                dS[x] = -infection;
+                dE[x] = infection - onset;
+                dI[x] = onset - recovery;
+                dR[x] = recovery;
+            }
+        }
+
+    private:
+        typedef enum {
+            NO_MOBILITY, DENSE_MOBILITY, SPARSE_MOBILITY
+        } mobilityType;
+
+        int P;                      // patches
+        int A;                      // groups per patch
+        double beta;                // transmission rate
+        double sigma;               // rate of becoming infectious
+        double gamma;               // recovery rate
+
+        vector<double> contact;     // A x A
+        bool contact_symmetric;
+        mobilityType mobility_mode;
+        vector<double> mobility;    // P x P, if dense
+        bool mobility_symmetric;
+        vector<int> mob_offsets;    // CSR, if sparse
+        vector<int> mob_cols;
+        vector<double> mob_values;
+
+        vector<double> inv_N;       // 1/N, by patch and group
+        vector<double> prevalence;  // derivative() workspace
+        vector<double> mixed;
+        vector<double> lambda;
+
+        // out = alpha * M * x, for an n x n matrix M
+        void matrix_vector(const vector<double>& M, bool symmetric, int n, double alpha, const double* x, double* out) {
+            if (symmetric) cblas_dsymv(CblasRowMajor, CblasUpper, n, alpha, &M[0], n, x, 1, 0.0, out, 1);
+            else cblas_dgemv(CblasRowMajor, CblasNoTrans, n, n, alpha, &M[0], n, x, 1, 0.0, out, 1);
+        }
+
+        double total(int compartment) {
+            double val = 0;
+            for (int x = 0; x < P * A; x++) val += y[compartment * P * A + x];
+            return val;
+        }
+};
+
+#endif
@@ -26,9 +26,11 @@ Network::Network( string name, netType directed) {
     this->unit_edges = 1;
     this->node_id_counter = 0;
     this->edge_id_counter = 0;
+    this->node_slot_counter = 0;
     this->_topology_altered=false;
-    this->process_stopped = false;
-    this->known_nodes = 0;
+    this->progress = NULL;
+    this->memory_budget = 0;
+    this->budget_policy = RefuseOverBudget;
 }
 
 
@@ -36,24 +38,25 @@ Network::Network(netType directed) : Network("", directed) { }
 
 
 Network* Network::duplicate() const {
+    INSTRUMENT_SPAN("duplicate");
     Network* dup = new Network( name, directed );
     dup->unit_edges         = unit_edges;
     dup->node_id_counter    = node_id_counter;
     dup->edge_id_counter    = edge_id_counter;
     dup->_topology_altered  = _topology_altered;
-    dup->process_stopped    = process_stopped;
-    dup->known_nodes        = known_nodes;
     dup->gen_deg_dist       = gen_deg_dist;
+    dup->memory_budget      = memory_budget;
+    dup->budget_policy      = budget_policy;
 
     // Make copies of all nodes
     for (int i = 0; i < size(); i++) {
         Node* node = node_list[i];
         Node* node_copy = new Node();
         node_copy->id    = node->get_id();
-        node_copy->name  = node->get_name();
-        node_copy->loc   = node->get_loc();
         node_copy->state = node->get_state();
         node_copy->set_network(dup);
+        if (node->slot < (signed) node_names.size()) node_copy->set_name( node->get_name() );
+        if (not node_coords.empty()) node_copy->set_loc( node->get_loc() );
 
         // Create a stub for each outbound edge
         // (since not all nodes have been created, we can't connect everything yet)
@@ -104,14 +107,18 @@ void Network::seed(std::uint32_t seed) {
     rng.seed(seed);
 }
 
-void Network::populate( int n ) {
+bool Network::populate( int n ) {
+    INSTRUMENT_SPAN("populate");
+    if (memory_budget and not _within_budget("populate()", size() + n, _mean_deg(), false)) return false;
     for (int i = 0; i < n; i++) {
         add_new_node();
     }
+    return true;
 }
 
 
 Node* Network::add_new_node() {
+    INSTRUMENT_COUNT("nodes created", 1);
     Node* node = new Node();     //allocate memory for new node
     node->id = node_id_counter++;
     node->set_network(this);     //set the network
@@ -146,15 +153,68 @@ Node* Network::get_node(int node_id) {
 
 
 Node* Network::get_node_by_name(string node_name) {
-    vector<Node*>::iterator itr;
-    for (itr = node_list.begin(); itr < node_list.end(); itr++) {
-        if ((*itr)->name == node_name) return *itr;
+    unordered_map<string, int>::const_iterator name = name_ids.find(node_name);
+    if (name != name_ids.end()) {
+        vector<Node*>::iterator itr;
+        for (itr = node_list.begin(); itr < node_list.end(); itr++) {
+            const int slot = (*itr)->slot;
+            if (slot < (signed) node_names.size() and node_names[slot] == name->second) return *itr;
+        }
     }
     cerr << "Couldn't find a node with name  " << node_name << endl;
     return NULL;
 }
 
 
+static const double NO_COORD = numeric_limits<double>::quiet_NaN();
+
+
+int Network::_intern(const string& name) {
+    if (name_pool.empty()) name_pool.push_back(NULL); // 0 means no name
+    pair<unordered_map<string, int>::iterator, bool> entry = name_ids.insert(make_pair(name, (int) name_pool.size()));
+    if (entry.second) name_pool.push_back(&entry.first->first);
+    return entry.first->second;
+}
+
+
+const string& Network::_node_name(int slot) const {
+    static const string no_name = "";
+    if (slot < 0 or slot >= (signed) node_names.size() or node_names[slot] == 0) return no_name;
+    return *name_pool[ node_names[slot] ];
+}
+
+
+void Network::_set_node_name(int slot, const string& name) {
+    if (name == "" and slot >= (signed) node_names.size()) return;
+    if (slot >= (signed) node_names.size()) node_names.resize(max(slot + 1, node_slot_counter), 0);
+    node_names[slot] = name == "" ? 0 : _intern(name);
+}
+
+
+vector<double> Network::_node_loc(int slot) const {
+    vector<double> loc;
+    for (unsigned int d = 0; d < node_coords.size(); d++) {
+        loc.push_back( slot < (signed) node_coords[d].size() ? node_coords[d][slot] : NO_COORD );
+    }
+    while (loc.size() > 0 and std::isnan(loc.back())) loc.pop_back();
+    return loc;
+}
+
+
+void Network::_set_node_loc(int slot, const vector<double>& loc) {
+    if (loc.size() > node_coords.size()) node_coords.resize(loc.size());
+    for (unsigned int d = 0; d < node_coords.size(); d++) {
+        vector<double>& column = node_coords[d];
+        const double x = d < loc.size() ? loc[d] : NO_COORD;
+        if (slot >= (signed) column.size()) {
+            if (std::isnan(x)) continue;
+            column.resize(max(slot + 1, node_slot_counter), NO_COORD);
+        }
+        column[slot] = x;
+    }
+}
+
+
 bool Network::is_weighted() {
     vector<Edge*> edges = get_edges();
     for( unsigned int i = 0; i<edges.size(); i++) {
@@ -171,6 +231,7 @@ bool Network::ring_lattice(int N, int K) {
         cerr << "Cannot construct a ring lattice with K-nearest neighbors where K > (network size - 1) / 2\n";
         return false;
     }
+    if (memory_budget and not _within_budget("ring_lattice()", N, 2*K, false)) return false;
     clear_nodes();
     populate(N);
     for (unsigned int i = 0; i < node_list.size(); i++) {
@@ -189,6 +250,7 @@ bool Network::square_lattice(int R, int C, bool diag) {
         cerr << "Square lattice must have at least one row and one column.\n";
         return false;
     }
+    if (memory_budget and not _within_budget("square_lattice()", (long) R*C, diag ? 8 : 4, false)) return false;
     clear_nodes();
     for (int i = 0; i < R; i++) {
         for (int j = 0; j < C; j++) {
@@ -268,20 +330,21 @@ bool Network::small_world(int N, int K, double beta) {
 
 // generates a poisson network vi the Erdos & Renyi algorithm
 bool Network::erdos_renyi(double lambda) {
+    INSTRUMENT_SPAN("erdos_renyi");
     int n = size();
     if (lambda > n-1) return false; // mean degree can't be bigger than network size - 1
+    if (memory_budget and not _within_budget("erdos_renyi()", n, _mean_deg() + lambda, false)) return false;
     double p = lambda / (n-1);
     vector<Node*> nodes = get_nodes();
+    begin_phase("Connecting nodes", (long) n * (n-1) / 2);
     for (int a = 0; a < n - 1; a++) {
-        if (is_stopped() ) { return false; }
+        if (cancelled()) { return false; }
         for (unsigned int b = a + 1; b < nodes.size(); b++) {
             if ( rand_uniform(0, 1, &rng) < p) {
                 nodes[a]->connect_to(nodes[b]);
             }
         }
-        //set_progress( (double) a / n );
-        PROG( (int) 100 * (1 - (double)(n-a)*(n-a-1) / (n*(n-1))) );
-        //cerr <<  1 - (double)(n-a)*(n-a-1) / (n*(n-1))  << endl;
+        report((long) n * (n-1) / 2 - (long) (n-a-1) * (n-a-2) / 2); // pairs considered so far
     }
     return true;
 }
@@ -289,19 +352,25 @@ bool Network::erdos_renyi(double lambda) {
 
 // generates a poisson network.  Faster than Erdos-Renyi for sparse graphs
 bool Network::sparse_random_graph(double lambda) {
+    INSTRUMENT_SPAN("sparse_random_graph");
     int n = size();
+    if (memory_budget and not _within_budget("sparse_random_graph()", n, _mean_deg() + lambda, true)) return false;
     long double p = lambda / (n-1);
     long double sd = sqrtl(n*lambda*(1-p));
     //sqrtl(n*(n-1)*p*(1-p)); // sometimes yields -nan (e.g. n=50000,lambda=5)
     double edge_ct = rand_normal(lambda * n, sd, &rng);
                                  // we're increasing the degree of 2 nodes!
+    begin_phase("Connecting nodes", (long) edge_ct);
     for (int i = 0; i < edge_ct; i += 2) {
+        if ((i & 1023) == 0) {
+            if (cancelled()) return false;
+            report(i);
+        }
         int a = rand_uniform_int(0, n-1, &rng);
         int b = rand_uniform_int(0, n-1, &rng);
                                  // for undirected graphs, this makes
         node_list[a]->connect_to(node_list[b]);
                                  // an undirected edge
-        PROG( (int) 50 * i/edge_ct );
     }
     return lose_loops();
 }
@@ -350,6 +419,8 @@ void Network::rand_connect_user(map<int,double>) {
 bool Network::rand_connect_explicit(vector<int> degree_series) {
     assert(degree_series.size() == node_list.size());
     assert(sum(degree_series) % 2 == 0);
+    if (memory_budget and not _within_budget("rand_connect_explicit()", size(),
+                                             _mean_deg() + (double) sum(degree_series) / max(size(), 1), true)) return false;
     for (unsigned int i = 0; i < degree_series.size(); i++ ) {
         node_list[i]->add_stubs(degree_series[i]);
     }
@@ -358,7 +429,7 @@ bool Network::rand_connect_explicit(vector<int> degree_series) {
 
 
 bool Network::rand_connect_user(vector<double> dist) {
-    if (is_stopped()) return false;
+    if (cancelled()) return false;
     gen_deg_dist = dist;
     return _rand_connect();
 }
@@ -366,6 +437,11 @@ bool Network::rand_connect_user(vector<double> dist) {
 
 // use this only if the generating degree dist has already been stored
 bool Network::_rand_connect() {
+    if (memory_budget) {
+        double expected_deg = 0;
+        for (unsigned int k = 0; k < gen_deg_dist.size(); k++) expected_deg += k * gen_deg_dist[k];
+        if (not _within_budget("rand_connect()", size(), _mean_deg() + expected_deg, true)) return false;
+    }
     if (_assign_deg_series()) {
         return rand_connect_stubs( get_edges() );
     } else {
@@ -375,7 +451,8 @@ bool Network::_rand_connect() {
 
 
 bool Network::rand_connect_stubs(vector<Edge*> stubs) {
-    if ( is_stopped() ) return false;
+    INSTRUMENT_SPAN("rand_connect_stubs");
+    if ( cancelled() ) return false;
     if ( stubs.size() == 0 ) return true;
     assert(stubs.size()%2 == 0);
                                  //get all edges in network
@@ -386,12 +463,13 @@ bool Network::rand_connect_stubs(vector<Edge*> stubs) {
     shuffle(stubs, &rng);
 
     //connect stubs
+    begin_phase("Connecting stubs", stubs.size());
     for (unsigned int i = 0; i < stubs.size() - 1; i += 2 ) {
         m  = stubs[i];
         n  = stubs[i  + 1];
         m->define_end(n->start);
         n->define_end(m->start);
-        PROG( 25 + (int) (25 * i / stubs.size()) );
+        if ((i & 1023) == 0) report(i);
     }
     // if lose_loops() isn't successful, return false
     if (! lose_loops()) { clear_edges(); return false; }
@@ -403,7 +481,8 @@ bool Network::rand_connect_stubs(vector<Edge*> stubs) {
 // and multi-edges (e.g. pairs of edges which have identical starts and ends)
 // Returns true on success, false if network could not be rewired
 bool Network::lose_loops() {
-    if ( is_stopped() ) return false;
+    INSTRUMENT_SPAN("lose_loops");
+    if ( cancelled() ) return false;
                                  //all (outbound) edges in the network
     vector<Edge*> edges = get_edges();
 
@@ -426,10 +505,11 @@ bool Network::lose_loops() {
 
     //shuffle the vector
     shuffle(bad_edges, &rng);
-    int max = bad_edges.size() - 1;
+    const long max = bad_edges.size();
 
+    begin_phase("Removing self-loops and multi-edges", max);
     while ( bad_edges.size() > 0 ) {
-        PROG( 50 + (int) (50 * (max - bad_edges.size()) / max) );
+        report(max - bad_edges.size());
         m = bad_edges.size() - 1;
         n = rand_uniform_int(0, edges.size() - 1, &rng);
         if ( failed_attempts > 99 ) {
@@ -438,7 +518,8 @@ bool Network::lose_loops() {
                 << endl;
             return false;
         }
-        if ( is_stopped() ) return false;
+        if ( cancelled() ) return false;
+        INSTRUMENT_COUNT("rewiring attempts", 1);
 
         Edge* edge1 = bad_edges[m];
         Edge* edge2 = edges[n];
@@ -484,6 +565,7 @@ bool Network::lose_loops() {
         }
 
         //        cerr << "swapping edges: " << edge1->id  << " " << edge2->id << endl;
+        INSTRUMENT_COUNT("edges rewired", 1);
         failed_attempts = 0;
         edge1->swap_ends(edge2);
     }
@@ -496,6 +578,7 @@ bool Network::lose_loops() {
 
 
 void Network::get_bad_edges(vector<Edge*> &self_loops, vector<Edge*> &multiedges) {
+    INSTRUMENT_SPAN("get_bad_edges");
     vector<Edge*> edges = get_edges();
 
     map< int, map <int, int> > seen_edges;
@@ -503,7 +586,9 @@ void Network::get_bad_edges(vector<Edge*> &self_loops, vector<Edge*> &multiedges
     Edge* edge;
     Node* start;
     Node* end;
+    begin_phase("Finding self-loops and multi-edges", edges.size());
     for(unsigned int i=0; i < edges.size(); i++ ) {
+        if ((i & 1023) == 0) report(i);
         edge = edges[i];
         start = edge->start;
         end = edge->end;
@@ -519,6 +604,7 @@ void Network::get_bad_edges(vector<Edge*> &self_loops, vector<Edge*> &multiedges
             seen_edges[ start->id ][ end->id ]++;
         }
     }
+    INSTRUMENT_COUNT("edges examined", edges.size());
 
     //cerr <<  "get_bad_edges() " << seen_edges.size() <<  " " << self_loops.size() <<  " " << multiedges.size() << endl;
 }
@@ -537,24 +623,25 @@ vector<Node*> Network::get_biggest_component() {
 
 
 vector< vector<Node*> > Network::get_components() {
+    INSTRUMENT_SPAN("get_components");
     vector< vector<Node*> > components;
     vector<Node*> temp_comp(0);
     set<Node*> seen_nodes;
-    PROG(0);
+    begin_phase("Finding components", size());
 
     for (unsigned int i=0; i<node_list.size(); i++) {
-    	if (is_stopped()) {
+    	if (cancelled()) {
     		vector< vector<Node*> > empty;
     	    return empty;
     	}
 
     	if (seen_nodes.count(node_list[i]) == 0) {
-    		temp_comp = get_component(node_list[i]);
+    		temp_comp = _get_component(node_list[i], seen_nodes.size());
     		components.push_back(temp_comp);
 
     		//for (int j=0; j<temp_comp.size(); j++) seen_nodes.insert(temp_comp[j]);
     		std::copy( temp_comp.begin(), temp_comp.end(), std::inserter( seen_nodes, seen_nodes.end() ) );
-
+    		report(seen_nodes.size());
     	}
     }
 
@@ -563,13 +650,23 @@ vector< vector<Node*> > Network::get_components() {
 
 
 vector<Node*> Network::get_component(Node* node) {
+    begin_phase("Finding component", size());
+    return _get_component(node, 0);
+}
+
+
+// seen is the number of nodes already assigned to other components, so that
+// progress can be reported for get_components() as a whole
+vector<Node*> Network::_get_component(Node* node, long seen) {
+    INSTRUMENT_SPAN("get_component");
     vector<Node*> hot_nodes;
-    set<Node*> cold_nodes;
+    set<Node*> cold_nodes;       // every node found so far
     hot_nodes.push_back(node);
+    cold_nodes.insert(node);
 
 
     while (hot_nodes.size() > 0) {
-        if (process_stopped) {
+        if (cancelled()) {
         	vector<Node*> output(cold_nodes.begin(), cold_nodes.end());
         	return output;
         }
@@ -578,16 +675,15 @@ vector<Node*> Network::get_component(Node* node) {
         for (unsigned int i = 0; i < hot_nodes.size(); i++) {
 
             vector<Node*> neighbors = hot_nodes[i]->get_neighbors();
+            INSTRUMENT_COUNT("edges examined", neighbors.size());
             for (unsigned int j = 0; j < neighbors.size(); j++) {
 
-                if ( cold_nodes.count(neighbors[j]) != 0 ) continue; // maybe you've already looked at this node
-                new_hot_nodes.push_back( neighbors[j] );
+                // nodes are marked when they are found, so none is queued twice
+                if ( cold_nodes.insert(neighbors[j]).second ) new_hot_nodes.push_back( neighbors[j] );
             }
-
-            PROG((int) 100*((float) (known_nodes + cold_nodes.size())/size() ));
         }
-        std::copy( hot_nodes.begin(), hot_nodes.end(), std::inserter( cold_nodes, cold_nodes.end() ) );
-        hot_nodes = new_hot_nodes;
+        hot_nodes.swap(new_hot_nodes);
+        report(seen + cold_nodes.size());
     }
     vector<Node*> output(cold_nodes.begin(), cold_nodes.end());
     return output;
@@ -595,15 +691,17 @@ vector<Node*> Network::get_component(Node* node) {
 
 
 bool Network::_assign_deg_series() {
+    INSTRUMENT_SPAN("assign_deg_series");
     int n = this->node_list.size();
     vector<int> deg_series(n);
 
-    if ( ! gen_deg_series(deg_series) ||  is_stopped() ) return false;
+    if ( ! gen_deg_series(deg_series) ||  cancelled() ) return false;
     int running_sum = 0;
+    begin_phase("Adding stubs", n);
     for (int i = 0; i < n; i++ ) {
         this->node_list[i]->add_stubs(deg_series[i]);
         running_sum += this->node_list[i]->deg();
-        PROG( (int) (25.0 * i / n));
+        if ((i & 1023) == 0) report(i);
     }
     assert(running_sum % 2 == 0);
     return true;
@@ -661,6 +759,117 @@ double Network::mean_deg () {
 }
 
 
+double Network::_mean_deg () const {
+    if (node_list.size() == 0) return 0;
+    long total = 0;
+    for (unsigned int i = 0; i < node_list.size(); i++) total += node_list[i]->deg();
+    return (double) total / node_list.size();
+}
+
+
+// Size of the heap block malloc uses for a request of this many bytes:
+// glibc adds an 8-byte header, rounds up to 16 and never hands out less than 32
+static size_t heap_block(size_t bytes) {
+    if (bytes == 0) return 0;
+    return max((size_t) 32, (bytes + 8 + 15) & ~(size_t) 15);
+}
+
+
+// Short strings are stored inside the string object itself
+static size_t heap_bytes(const string& s) {
+    const char* data = s.data();
+    const char* object = (const char*) &s;
+    if (data >= object and data < object + sizeof(string)) return 0;
+    return heap_block(s.capacity() + 1);
+}
+
+
+template<typename T> static size_t heap_bytes(const vector<T>& v) {
+    return heap_block(v.capacity() * sizeof(T));
+}
+
+
+// vectors filled by push_back() grow by doubling
+static size_t grown_capacity(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) capacity *= 2;
+    return n == 0 ? 0 : capacity;
+}
+
+
+MemoryUsage Network::memory_usage() const {
+    MemoryUsage usage;
+    usage.nodes = heap_bytes(node_list);
+    usage.caches = heap_bytes(gen_deg_dist) + heap_bytes(name);
+    for (unsigned int i = 0; i < node_list.size(); i++) {
+        const Node* node = node_list[i];
+        usage.nodes     += heap_block(sizeof(Node));
+        usage.edges     += node->edges_out.size() * heap_block(sizeof(Edge));
+        usage.adjacency += heap_bytes(node->edges_in) + heap_bytes(node->edges_out);
+    }
+
+    // a hash table entry holds the next pointer and the cached hash besides the pair
+    const size_t name_entry = heap_block(sizeof(void*) + sizeof(pair<const string, int>) + sizeof(size_t));
+    usage.names = heap_bytes(node_names) + heap_bytes(name_pool)
+                + name_ids.size() * name_entry + heap_block(name_ids.bucket_count() * sizeof(void*));
+    for (unordered_map<string, int>::const_iterator it = name_ids.begin(); it != name_ids.end(); it++) {
+        usage.names += heap_bytes(it->first);
+    }
+    usage.locations = heap_bytes(node_coords);
+    for (unsigned int d = 0; d < node_coords.size(); d++) usage.locations += heap_bytes(node_coords[d]);
+    return usage;
+}
+
+
+MemoryUsage Network::estimate_memory(long nodes, double mean_deg) {
+    MemoryUsage usage;
+    // an undirected connection is two edges, so either way there are mean_deg per node
+    const double edges = nodes * mean_deg;
+    const size_t adjacency_list = heap_block(grown_capacity(ceil(mean_deg)) * sizeof(Edge*));
+    usage.nodes     = nodes * heap_block(sizeof(Node)) + heap_block(grown_capacity(nodes) * sizeof(Node*));
+    usage.edges     = edges * heap_block(sizeof(Edge));
+    usage.adjacency = 2 * nodes * adjacency_list;
+    usage.caches    = heap_block(nodes * sizeof(double)); // generating degree distribution
+
+    // While lose_loops() runs there are three lists of all edges (the stubs
+    // being connected, and the copies in lose_loops() and get_bad_edges()) and
+    // get_bad_edges()' map of the edges seen, with an entry per edge and a map
+    // per node.  A map node holds a colour and three pointers besides the entry.
+    const size_t tree_node = 4 * sizeof(void*);
+    const size_t edge_list = heap_block(grown_capacity(edges) * sizeof(Edge*));
+    const size_t seen_edge = heap_block(tree_node + sizeof(pair<const int, int>));
+    const size_t seen_node = heap_block(tree_node + sizeof(pair<const int, map<int, int> >));
+    usage.working   = 3 * edge_list + edges * seen_edge + nodes * seen_node;
+    return usage;
+}
+
+
+bool Network::_within_budget(const char* operation, long nodes, double mean_deg, bool matches_stubs) {
+    const MemoryUsage estimate = estimate_memory(nodes, mean_deg);
+    const size_t peak = matches_stubs ? estimate.peak() : estimate.total();
+    if (peak <= memory_budget) return true;
+    const bool refuse = budget_policy == RefuseOverBudget;
+    cerr << operation << ": a network of " << nodes << " nodes with mean degree " << mean_deg
+         << " needs about " << peak / 1048576 << " MB, more than the budget of "
+         << memory_budget / 1048576 << " MB" << (refuse ? "; not generating it" : "") << endl;
+    return not refuse;
+}
+
+
+ostream& operator<< (ostream &out, const MemoryUsage& usage) {
+    const char* labels[] = {"nodes", "edges", "adjacency", "names", "locations", "caches", "working"};
+    const size_t bytes[] = {usage.nodes, usage.edges, usage.adjacency, usage.names, usage.locations, usage.caches, usage.working};
+    for (int i = 0; i < 7; i++) {
+        if (i == 6 and usage.working == 0) break;
+        out << labels[i] << ": " << bytes[i] << " bytes\n";
+    }
+    out << "total: " << usage.total() << " bytes";
+    if (usage.working) out << " (" << usage.peak() << " at peak)";
+    out << endl;
+    return out;
+}
+
+
 map<Node*, int> Network::k_shell_decomposition() {
     map<Node*, int> ks;
     // Initialize values to the nodes' degrees
@@ -759,13 +968,29 @@ vector< vector<int> > Network::get_states_by_degree() {
 
 
 double Network::transitivity (vector<Node*> node_set) {
+    INSTRUMENT_SPAN("transitivity");
     if (node_set.size() == 0) node_set = node_list;
-    int triangles = 0;
-    int tripples  = 0;
-    Node *a, *b, *c;
+    long long triangles = 0;
+    long long tripples  = 0;
+    const int n = node_list.size();
+    const int block = 256;
+
+    begin_phase("Calculating transitivity", size());
+    for (int first = 0; first < n; first += block) {
+        if (cancelled()) return -1 * std::numeric_limits<float>::max();
+        const int last = min(n, first + block);
+        transitivity(first, last, triangles, tripples);
+        report(last);
+    }
+    INSTRUMENT_COUNT("edges examined", tripples);
+    return (double) triangles / (double) tripples ;
+}
 
-    for (unsigned int i = 0; i < node_list.size(); i++) {
-        if (is_stopped()) return -1 * std::numeric_limits<float>::max();
+
+void Network::transitivity (int first, int last, long long& triangles, long long& tripples) {
+    assert(first >= 0 and first <= last and last <= (int) node_list.size());
+    Node *a, *b, *c;
+    for (int i = first; i < last; i++) {
         a = node_list[i];
         vector<Node*> neighborhood_a = a->get_neighbors();
         for (unsigned int j = 0; j < neighborhood_a.size(); j++) {
@@ -778,9 +1003,7 @@ double Network::transitivity (vector<Node*> node_set) {
                 tripples++;
             }
         }
-        PROG(100*i/size());
     }
-    return (double) triangles / (double) tripples ;
 }
 
 
@@ -806,7 +1029,9 @@ double Network::mean_dist(vector<Node*> node_set) {    // average distance betwe
 // all nodes within a single component
 // Assumes undirected network
 void Network::calculate_distances(vector<Node*>& full_node_set, vector< vector<double> >& dist)  {
+    INSTRUMENT_SPAN("calculate_distances");
     if (full_node_set.size() == 0) full_node_set = node_list;
+    begin_phase("Calculating distances", full_node_set.size() - 1);
     for(unsigned int i = 0; i < full_node_set.size() - 1; i++ ) {
         vector<Node*> node_set;
         for(unsigned int j = i+1; j < full_node_set.size(); j++ ) {
@@ -816,27 +1041,35 @@ void Network::calculate_distances(vector<Node*>& full_node_set, vector< vector<d
         vector<double> empty;
         dist.push_back(empty);
 
-        if (is_stopped() ) {
+        if (cancelled()) {
             return;
         }
 
-        PROG(100*(i-1)/node_set.size());
         dist[i] = full_node_set[i]->min_paths(node_set);
+        report(i + 1);
     }
     return;
 }
 
 
 PairwiseDistanceMatrix Network::calculate_distances_map() {
+    INSTRUMENT_SPAN("calculate_distances_map");
     PairwiseDistanceMatrix dist_map;
+    begin_phase("Calculating distances", size());
     if (is_directed()) {
-        for (Node* n: node_list) dist_map[n] = n->min_path_map();
+        for (unsigned int i=0; i<node_list.size(); ++i){
+            if (cancelled()) return dist_map;
+            dist_map[node_list[i]] = node_list[i]->min_path_map();
+            report(i + 1);
+        }
     } else {
         PairwiseDistanceMatrix tmp_dist_map;
         for (unsigned int i=0; i<node_list.size(); ++i){
+            if (cancelled()) return dist_map;
             const Node* n = node_list[i];
             vector<Node*> node_subset = vector<Node*>(node_list.begin()+i, node_list.end());
             tmp_dist_map[n] = n->min_path_map(node_subset);
+            report(i + 1);
         }
 
         for (pair<const Node*, DistanceMatrix> pair_ndm: tmp_dist_map) {
@@ -864,7 +1097,7 @@ void Network::print_distances(vector<Node*>& full_node_set)  {
 
     for(unsigned int i = 0; i < full_node_set.size() - 1; i++ ) {
         for(unsigned int j = i+1; j < full_node_set.size(); j++ ) {
-            cout << full_node_set[i]->name << "\t" << full_node_set[j]->name << "\t" << dist[i][j-i-1] << endl;
+            cout << full_node_set[i]->get_name() << "\t" << full_node_set[j]->get_name() << "\t" << dist[i][j-i-1] << endl;
         }
     }
     return;
@@ -907,6 +1140,11 @@ Node* Network::get_rand_node() {
 void Network::clear_nodes() {
     for (int i = 0; i < size(); i++) delete node_list[i];
     node_list.clear();
+    node_slot_counter = 0;
+    name_ids.clear();
+    name_pool.clear();
+    node_names.clear();
+    node_coords.clear();
     set_topology_altered(true);
 }
 
@@ -1050,9 +1288,11 @@ bool Network::validate() {
 
 // read_edgelist currently supports only undirected networks
 void Network::read_edgelist(string filename, char sep, bool alert_on_singleton) {
+    INSTRUMENT_SPAN("read_edgelist");
     ifstream myfile(filename.c_str());
-    std::stringstream ss;
-    map<string,Node*> idmap;
+    // nodes created here, by the index of their interned name; names are only
+    // stored once, in the network's name pool
+    vector<Node*> named;
 
     if (myfile.is_open()) {
         string line;
@@ -1068,39 +1308,36 @@ void Network::read_edgelist(string filename, char sep, bool alert_on_singleton)
                 cerr << "Skipping line: too many fields: " << line << endl;
                 continue;
             } else if (fields.size() == 1) { // unconnected node
-                Node* node = this->add_new_node();
-                string name1 = strip(fields[0],whitespace);
+                const string name1 = strip(fields[0],whitespace);
                 if (alert_on_singleton) cerr << "Found single node " << name1 << endl;
-                node->name = name1;
-                idmap[name1] = node;
+                _read_node(named, name1);
                 continue;
             } else if (fields.size() < 1) { // empty line
                 continue;
             } else { // there are exactly 2 nodes
 
-                string name1 = strip(fields[0],whitespace);
-                string name2 = strip(fields[1],whitespace);
-
-                //node1 is new; allocate memory
-                if(idmap.count(name1)==0) {
-                    Node* node = this->add_new_node();
-                    node->name = name1;
-                    idmap[name1] = node;
-                }
-
-                //node2 is new; allocate memory
-                if(idmap.count(name2)==0) {
-                    Node* node = this->add_new_node();
-                    node->name = name2;
-                    idmap[name2]=node;
-                }
-
-                idmap[name1]->connect_to(idmap[name2]);
+                Node* node1 = _read_node(named, strip(fields[0],whitespace));
+                Node* node2 = _read_node(named, strip(fields[1],whitespace));
+                node1->connect_to(node2);
             }
         }
     }
 }
 
+// The node read_edgelist() has already created with this name, or a new one
+Node* Network::_read_node(vector<Node*>& named, const string& name) {
+    const int name_id = _intern(name);
+    if (name_id >= (signed) named.size()) named.resize(name_id + 1, NULL);
+    if (named[name_id] == NULL) {
+        Node* node = add_new_node();
+        if (node->slot >= (signed) node_names.size()) node_names.resize(max(node->slot + 1, node_slot_counter), 0);
+        node_names[node->slot] = name_id;
+        named[name_id] = node;
+    }
+    return named[name_id];
+}
+
+
 bool Network::add_edgelist(ifstream& source, char sep, string breaker) {
     std::stringstream ss;
     const char whitespace[] = " \n\t\r";
@@ -1153,6 +1390,7 @@ bool Network::add_edgelist(ifstream& source, char sep, string breaker) {
 
 
 void Network::write_edgelist(string filename, outputType ot, char sep) {
+    INSTRUMENT_SPAN("write_edgelist");
     if (filename == "") filename = "edgelist.out";
 
     ofstream pipe(filename.c_str(), ios::out);
@@ -1168,14 +1406,14 @@ void Network::write_edgelist(string filename, outputType ot, char sep) {
                 if (edges[e]->id > comp->id) continue;
             }
             if (ot == NodeNames) {
-                pipe << edges[e]->start->name << sep << edges[e]->end->name << endl;
+                pipe << edges[e]->start->get_name() << sep << edges[e]->end->get_name() << endl;
             } else {
                 pipe << start_id << sep << end_id << endl;
             }
         }
         if (node_list[i]->deg() == 0) {
             if (ot == NodeNames) {
-                pipe << node_list[i]->name << endl;
+                pipe << node_list[i]->get_name() << endl;
             } else {
                 pipe << node_list[i]->id << endl;
             }
@@ -1285,13 +1523,6 @@ void Network::graphviz (string filename) {
     pipe.close();
 }
 
-bool Network::is_stopped() {
-    bool status = process_stopped;
-    process_stopped = false;
-    return status;
-}
-
-
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Node Class Functions
@@ -1299,17 +1530,17 @@ bool Network::is_stopped() {
 ///////////////////////////////////////////////////////////////////////////////
 
 Node::Node(Network* network, string name, stateType state) {
-    this->network = network;
+    set_network(network);
     this->id = network->node_id_counter++;
-    this->name = name;
     this->state = state;
+    set_name(name);
 }
 
 
 Node::Node() {                   //empty constructor
     this->network = NULL;
     this->id = -1;
-    this->name= "";
+    this->slot = -1;
     this->state = 0;
 }
 
@@ -1330,8 +1561,23 @@ void Node::delete_node() {
 }
 
 
+// The node gets a new slot in the network's tables, so any name or location
+// it had in another network is not carried over
 void Node::set_network(Network* network) {
     this->network = network;
+    this->slot = network ? network->node_slot_counter++ : -1;
+}
+
+
+void Node::set_name(const string& name) {
+    assert(network != NULL);
+    network->_set_node_name(slot, name);
+}
+
+
+void Node::set_loc(const vector<double>& newloc) {
+    assert(network != NULL);
+    network->_set_node_loc(slot, newloc);
 }
 
 
@@ -1341,6 +1587,7 @@ void Node::add_stubs(int deg) {
 
 
 Edge* Node::add_stub_out () {
+    INSTRUMENT_COUNT("edges created", 1);
     Edge* stub = new Edge(this,NULL);
     edges_out.push_back(stub);
     network->set_topology_altered(true);
@@ -1349,6 +1596,7 @@ Edge* Node::add_stub_out () {
 
 
 string Node::get_name_or_id () {
+    const string name = get_name();
     return (name != "") ? name : to_string(id);
 }
 
@@ -1495,10 +1743,11 @@ ostream& operator<< (ostream &out, Node* node) {
 
 void Node::dumper() const {
 
-    cerr << "\tname => " << name << endl;
+    cerr << "\tname => " << get_name() << endl;
     cerr << "\tid => "<< id << endl;
     cerr << "\tdegree => " << deg() <<  endl;
     cerr << "\tlocation => ";
+    vector<double> loc = get_loc();
     copy( loc.begin(), loc.end(), ostream_iterator<double>(cerr, " "));
     cerr << endl;
 
@@ -1555,12 +1804,13 @@ DistanceMatrix Node::_min_unweighted_paths(vector<Node*>& nodes) const {
 
     int j = hits.count(this); //How many shortest paths we know for nodes in 'nodes' variable
     while ( ! Q.empty() ) {
-        if (get_network()->process_stopped) {return known_cost;}
+        if (get_network()->cancelled()) {return known_cost;}
         const Node* known_node = Q.front();
         Q.pop();
 
         //Get the outbound edges for this known node
         vector <Node*> neighbors = known_node->get_neighbors();
+        INSTRUMENT_COUNT("edges examined", neighbors.size());
         for (unsigned int i = 0; i < neighbors.size(); i++) {
             Node* v = neighbors[i];
 
@@ -1588,6 +1838,7 @@ bool MapNodeComp::operator() (const Node* const& lhs, const Node* const& rhs) co
 
 
 DistanceMatrix Node::min_path_map(vector<Node*>& nodes) const {
+    INSTRUMENT_SPAN("min_path_map");
     DistanceMatrix known_cost;
     if (network->is_weighted()) {
         known_cost = _min_paths(nodes);
@@ -1634,7 +1885,7 @@ DistanceMatrix Node::_min_paths(vector<Node*>& nodes) const {
     int j = 0;
                                  //As long as there are nodes with uncertain min costs
     while ( j++ < (signed) nodes.size() ) {
-        if (get_network()->process_stopped) {return known_cost;}
+        if (get_network()->cancelled()) {return known_cost;}
 
         Node* min = NULL;
                                  //Loop through the nodes we know about.
@@ -1644,6 +1895,7 @@ DistanceMatrix Node::_min_paths(vector<Node*>& nodes) const {
                                  //Get the outbound edges for this known node
 
             vector <Edge*> edges = known_node->edges_out;
+            INSTRUMENT_COUNT("edges examined", edges.size());
             for (unsigned int i = 0; i < edges.size(); i++) {
                                  //Get this neighbor
                 Node* neighbor = edges[i]->end;
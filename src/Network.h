@@ -8,6 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <list>
 #include <algorithm>
@@ -17,7 +18,8 @@
 #include <random>
 #include <limits>
 
-#include "debug.h"
+#include "Progress.h"
+#include "Instrument.h"
 
 using namespace std;
 
@@ -29,6 +31,31 @@ struct MapNodeComp { bool operator() (const Node* const& lhs, const Node* const&
 typedef map<const Node*, double, MapNodeComp> DistanceMatrix;
 typedef map<const Node*, DistanceMatrix, MapNodeComp> PairwiseDistanceMatrix;
 
+/******************************************************************************
+ * Heap memory held by a network, in bytes, as returned by
+ * Network::memory_usage() or predicted by Network::estimate_memory().  Sizes
+ * include the allocator's per-block overhead (as glibc's malloc rounds them),
+ * so they are close to what the process actually uses.
+ *
+ *      nodes       Node objects and the network's node list
+ *      edges       Edge objects (an undirected connection is two of them)
+ *      adjacency   each node's vectors of inbound and outbound edges
+ *      names       the interned node names, and which node has which
+ *      locations   node coordinates
+ *      caches      the stored generating degree distribution and the like
+ *      working     temporary memory needed while generating (estimates only)
+ *****************************************************************************/
+struct MemoryUsage {
+    size_t nodes, edges, adjacency, names, locations, caches, working;
+
+    MemoryUsage() : nodes(0), edges(0), adjacency(0), names(0), locations(0), caches(0), working(0) {}
+                                 // everything but working memory
+    size_t total() const { return nodes + edges + adjacency + names + locations + caches; }
+    size_t peak() const { return total() + working; }
+};
+
+ostream& operator<< (ostream &out, const MemoryUsage& usage);
+
 /******************************************************************************
  * These classes have a natural heirarchy of Network > Node > Edge.  That means
  * you probably should not be doing something with nodes unless they already
@@ -146,7 +173,7 @@ class Network
         static void seed(); //seeds the PRNG with a random seed
         static void seed(uint32_t seed); //seeds the PRNG with custom seed
         Node* add_new_node();    //creates new node and adds it to the network
-        void populate(int n);    //add "n" new nodes to the network
+        bool populate(int n);    //add "n" new nodes to the network (false if over budget)
                                  // add an existing node to the network
         void add_node( Node* node );
                                  // delete a specified node (deleting associated edges)
@@ -265,6 +292,11 @@ class Network
         double transitivity() { return transitivity(get_nodes()); }
                                  // if node_set is empty, use all nodes
         double transitivity(vector<Node*> node_set);
+                                 // adds the triangles and connected triples
+                                 // starting at nodes first ... last-1 (indices
+                                 // into get_nodes()) to the counts, so that
+                                 // blocks of nodes can be counted in parallel
+        void transitivity(int first, int last, long long& triangles, long long& tripples);
         bool is_weighted();      // do any edges have edge costs other than 1?
         double mean_dist( vector<Node*> node_set=vector<Node*>());      // mean distANCE between all nodes A and B
                                  // 2D matrix of distances
@@ -278,15 +310,47 @@ class Network
 
 
 
+        /***************************************************************************
+         * Memory use
+         **************************************************************************/
+                                 // heap memory currently held, by category
+        MemoryUsage memory_usage() const;
+                                 // predicted footprint of a network with this many nodes
+                                 // and this mean degree, and the working memory needed to
+                                 // generate it with the rand_connect* functions.  Assumes
+                                 // every node has the mean degree and nodes have no names
+                                 // or locations.
+        static MemoryUsage estimate_memory(long nodes, double mean_deg);
+
+        // With a budget set, populate() and the generators estimate the peak memory
+        // of what they are about to build first (its working memory counts only for
+        // the generators that match stubs).  If it would exceed the budget
+        // they print a warning, and with RefuseOverBudget (the default) they also
+        // return false without changing the network.  A budget of 0 means none.
+        typedef enum { RefuseOverBudget=0, WarnOverBudget=1 } budgetPolicy;
+        void set_memory_budget(size_t bytes, budgetPolicy policy = RefuseOverBudget) {
+            memory_budget = bytes;
+            budget_policy = policy;
+        }
+        size_t get_memory_budget() const { return memory_budget; }
+
         /***************************************************************************
          * Process status & control
          **************************************************************************/
-        // Allows outside control of terminating some long-running network processes
-        void stop_processing() { process_stopped = true; }
-        void reset_processing_flag() { process_stopped = false; }
+        // Long-running methods (generators, components, transitivity, distances)
+        // report their phase and how far along they are to a Progress, if one is
+        // set, and return early once it has been cancelled.  The network does not
+        // own it; pass NULL to stop reporting.  Copies made by duplicate() have
+        // none.  (This replaces stop_processing() and reset_processing_flag():
+        // cancel or reset the Progress instead.)
+        void set_progress(Progress* p) { progress = p; }
+        Progress* get_progress() const { return progress; }
+        bool cancelled() const { return progress and progress->cancelled(); }
 
     private:
-        bool is_stopped();       // checks process status, resets to false if true
+        void begin_phase(const char* name, long total) { if (progress) progress->begin_phase(name, total); }
+        void report(long done) { if (progress) progress->set_done(done); }
+        vector<Node*> _get_component(Node* node, long seen);
         int id;                  // unique id for the node
         string name;
         vector<Node*> node_list;
@@ -305,10 +369,36 @@ class Network
         // to draw deviates from) has already been stored.
         bool _rand_connect();
 
-        // This is checked during some long-running processes to determine whether to
-        // continue
-        volatile bool process_stopped;
-        int known_nodes; // bookkeeping var; allows get_component() to report % complete
+        // false if a network of this size would be over budget and the policy is to
+        // refuse.  Only generators that match stubs and call lose_loops() need the
+        // estimate's working memory.
+        bool _within_budget(const char* operation, long nodes, double mean_deg, bool matches_stubs);
+        double _mean_deg() const; // 0 for an empty network
+
+        // Names and locations are optional, and most networks have neither, so
+        // rather than every node carrying a string and a vector they are kept
+        // here, by the node's slot, and take no space until something is set.
+        // Names are interned: each distinct name is stored once, in name_ids,
+        // and node_names holds its index in name_pool (0 for no name).
+        // Locations are stored by coordinate, one column per dimension, with
+        // NaN where a node has none.  Slots of deleted nodes, and names no
+        // node has any more, are not reclaimed until clear_nodes().
+        int node_slot_counter;
+        unordered_map<string, int> name_ids;
+        vector<const string*> name_pool;
+        vector<int> node_names;
+        vector< vector<double> > node_coords;
+
+        int _intern(const string& name);
+        const string& _node_name(int slot) const;
+        void _set_node_name(int slot, const string& name);
+        vector<double> _node_loc(int slot) const;
+        void _set_node_loc(int slot, const vector<double>& loc);
+        Node* _read_node(vector<Node*>& named, const string& name);
+
+        Progress* progress;     // not owned; may be NULL
+        size_t memory_budget;   // bytes; 0 if there is none
+        budgetPolicy budget_policy;
 };
 
 class Node
@@ -318,8 +408,6 @@ class Node
 
     public:
 
-        inline bool is_stopped() {return network->is_stopped();}
-
         /***************************************************************************
          * Constructor and Destructor
          **************************************************************************/
@@ -329,14 +417,17 @@ class Node
         void set_network( Network* network );
 
         inline int get_id() const { return id; }
-        inline string get_name() {  return name; }
+        inline string get_name() const { return network ? network->_node_name(slot) : ""; }
         inline Network* get_network() const { return network; }
         inline vector<Edge*> get_edges_in() const { return edges_in; }
         inline vector<Edge*> get_edges_out() const { return edges_out; }
-        inline vector<double> get_loc() const { return loc; }
+        inline vector<double> get_loc() const { return network ? network->_node_loc(slot) : vector<double>(); }
         inline stateType get_state() const { return state; }
 
-        inline void set_loc(const vector<double>& newloc) { this->loc = newloc; }
+                                 // names and locations are kept by the network, so
+                                 // the node must belong to one
+        void set_name(const string& name);
+        void set_loc(const vector<double>& newloc);
         inline void set_state(stateType s) { this->state = s; }
 
         double mean_min_path();
@@ -372,11 +463,10 @@ class Node
         ~Node();
 
         int id;                  //unique id
-        string name;
+        int slot;                //row in the network's name and location tables
         Network* network;        //pointer to network
         vector<Edge*> edges_in;  //vector of pointers coming in
         vector<Edge*> edges_out; //vector of pointers going out
-        vector<double> loc;
         stateType state;
         void _add_inbound_edge (Edge* edge);
         void _del_inbound_edge (Edge* inbound);
@@ -36,6 +36,7 @@ class Percolation_Sim: public Simulator
         }
 
         void step_simulation () {
+            INSTRUMENT_SPAN("Percolation_Sim::step_simulation");
             assert(infected.size() > 0);
             time++;
             //cerr << "\t" << infected.size() << endl;
@@ -43,6 +44,7 @@ class Percolation_Sim: public Simulator
             for (unsigned int i = 0; i < infected.size(); i++) {
                 Node* inode = infected[i];
                 vector<Node*> neighbors = inode->get_neighbors();
+                INSTRUMENT_COUNT("edges examined", neighbors.size());
                 for (unsigned int j = 0; j < neighbors.size(); j++) {
                     Node* test = neighbors[j];
                     if ( test->get_state() == S && rand_uniform(0, 1, rng) < T ) {
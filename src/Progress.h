@@ -0,0 +1,99 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+/******************************************************************************
+ * Progress reporting and cancellation for long-running operations, such as
+ * network generation and analysis.  One Progress object is shared between the
+ * code doing the work and whoever is watching it (a GUI timer, or the main
+ * thread of a command-line program), and every member is an atomic, so it can
+ * be read, updated and cancelled from any thread without locks.
+ *
+ * Work is divided into phases.  begin_phase() starts the next one, with a name
+ * and an amount of work; the worker then calls advance() or set_done() as it
+ * goes.  Watchers poll phase(), phase_name(), fraction() and eta().  Phase
+ * numbers only increase, so a watcher can tell that a phase has ended even if
+ * the next one has the same name.  Names are not copied: they must outlive
+ * the operation (the library only uses string literals).
+ *
+ * cancel() asks the operation to stop; code doing the work checks cancelled()
+ * every so often and returns early.  Unlike the old Network::process_stopped
+ * flag, reading it does not clear it, so every thread working on the
+ * operation sees the request.  It stays set until reset().
+ *
+ * Network holds a pointer to a Progress (see Network::set_progress()), which
+ * is NULL unless someone is listening, in which case reporting costs one test
+ * of that pointer.
+ *****************************************************************************/
+
+class Progress {
+    public:
+        Progress() { reset(); }
+
+        // Start over: clears the cancellation request, the phase and the counts
+        void reset() {
+            _cancelled.store(false);
+            _total.store(0);
+            _done.store(0);
+            _start.store(now());
+            _name.store("");
+            _phase.store(0);
+        }
+
+        void cancel() { _cancelled.store(true, memory_order_relaxed); }
+        bool cancelled() const { return _cancelled.load(memory_order_relaxed); }
+
+        void begin_phase(const char* name, long total) {
+            _total.store(total, memory_order_relaxed);
+            _done.store(0, memory_order_relaxed);
+            _start.store(now(), memory_order_relaxed);
+            _name.store(name, memory_order_relaxed);
+            _phase.fetch_add(1, memory_order_release);
+        }
+
+        void advance(long n = 1) { _done.fetch_add(n, memory_order_relaxed); }
+        void set_done(long n) { _done.store(n, memory_order_relaxed); }
+        void set_total(long n) { _total.store(n, memory_order_relaxed); }
+
+        int phase() const { return _phase.load(memory_order_acquire); }
+        const char* phase_name() const { return _name.load(memory_order_relaxed); }
+        long done() const { return _done.load(memory_order_relaxed); }
+        long total() const { return _total.load(memory_order_relaxed); }
+
+        // fraction of the current phase that is done, in [0, 1]
+        double fraction() const {
+            const long t = total();
+            if (t <= 0) return 0.0;
+            const long d = done();
+            return d >= t ? 1.0 : (double) d / t;
+        }
+
+        // seconds since the current phase began
+        double elapsed() const { return (now() - _start.load(memory_order_relaxed)) * 1e-9; }
+
+        // seconds left in the current phase, assuming the rate so far holds; -1
+        // until there is something to go on
+        double eta() const {
+            const double f = fraction();
+            if (f <= 0.0) return -1;
+            return elapsed() * (1.0 - f) / f;
+        }
+
+    private:
+        atomic<bool> _cancelled;
+        atomic<int> _phase;
+        atomic<const char*> _name;
+        atomic<long> _total;
+        atomic<long> _done;
+        atomic<long long> _start;   // steady clock, ns
+
+        static long long now() {
+            return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+        }
+};
+
+#endif
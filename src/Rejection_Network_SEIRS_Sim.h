@@ -0,0 +1,214 @@
+#ifndef REJECTION_NET_SEIRS_SIM_H
+#define REJECTION_NET_SEIRS_SIM_H
+
+#include <stdlib.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <iostream>
+#include "Utility.h"
+#include "Network.h"
+#include "Adjacency.h"
+
+using namespace std;
+
+/******************************************************************************
+ * Same model and interface as Gillespie_Network_SEIRS_Sim, but without an
+ * event queue.  This follows the optimized Gillespie algorithm of Cota &
+ * Ferreira (2017): the exposed and infectious nodes are kept in flat lists,
+ * and each step draws the time to the next event from the total rate, picks
+ * the kind of event in proportion to its share of that rate, and then picks
+ * the node that it happens to from the relevant list.  Every step is O(1)
+ * (amortized, in the PER_EDGE case), no matter how many nodes are infected.
+ *
+ * Contacts to nodes that aren't susceptible are simply wasted, as in the
+ * original class.  Loss of immunity happens a fixed time after recovery, so
+ * recovered nodes wait in a first-in first-out queue instead of a heap.
+ *
+ * By default each infectious node makes contacts at rate beta with randomly
+ * chosen neighbors, as in Gillespie_Network_SEIRS_Sim.  With PER_EDGE, beta is
+ * instead the rate of contact across each edge, so an infectious node with
+ * degree k makes contacts at rate k * beta.  The contacting node is then chosen
+ * by rejection sampling: pick an infectious node uniformly and accept it with
+ * probability k / k_max.
+ *****************************************************************************/
+
+class Rejection_Network_SEIRS_Sim {
+    public:
+        // S -> E -> I -> R -> S
+        typedef enum {
+            SUSCEPTIBLE, EXPOSED, INFECTIOUS, RESISTANT, STATE_SIZE // STATE_SIZE must be last
+        } stateType;
+
+        typedef enum {
+            PER_NODE, PER_EDGE
+        } contactRateType;
+                                    // constructor
+        Rejection_Network_SEIRS_Sim ( Network* net, double m, double b, double g, double im_dur, contactRateType cr = PER_NODE) {
+            network = net;
+            adj.build(net);
+            mu = m;
+            beta = b;
+            gamma = g;
+            immunity_duration = im_dur; // Immunity duration is fixed (not exponentially distributed)
+            contact_rate = cr;
+            max_deg = 0;
+            for (int i = 0; i < adj.size(); i++) max_deg = MAX(max_deg, adj.deg(i));
+            reset();
+        }
+
+        Network* network;           // population
+        double mu;                  // param for exponential exposed duration
+        double beta;                // param for exponential time to transmission
+        double gamma;               // param for exponential time to recovery
+        double immunity_duration;   // duration of recovered/resistant state before becoming susceptible
+        contactRateType contact_rate;
+
+        vector<int> state_counts;   // S, E, I, R counts
+        double Now;                 // Current "time" in simulation
+
+        mt19937 rng;              // RNG
+
+        void run_simulation(double duration) {
+            double start_time = Now;
+            int day = (int) Now;
+            while (next_event() and Now < start_time + duration) {
+                if ((int) Now > day) {
+                    cout << (int) Now << " : "  << state_counts[SUSCEPTIBLE] << "\t"
+                                          << state_counts[EXPOSED] << "\t"
+                                          << state_counts[INFECTIOUS] << "\t"
+                                          << state_counts[RESISTANT] << endl;
+                    day = (int) Now;
+                }
+
+                continue;
+            }
+        }
+
+        int current_epidemic_size() {
+            return state_counts[EXPOSED] + state_counts[INFECTIOUS];
+        }
+
+        void reset() {
+            Now = 0.0;
+
+            for (int i = 0; i < adj.size(); i++) adj.nodes[i]->set_state(SUSCEPTIBLE);
+            state.assign(adj.size(), SUSCEPTIBLE);
+            position.assign(adj.size(), -1);
+
+            state_counts.clear();
+            state_counts.resize(STATE_SIZE, 0);
+            state_counts[SUSCEPTIBLE] = adj.size();
+
+            exposed.clear();
+            infectious.clear();
+            infectious_deg_sum = 0;
+            waning.clear();
+        }
+
+        void rand_infect(int n) {   // randomly infect n people
+            assert(n > -1 and n <= adj.size());
+            vector<int> sample(n);
+            rand_nchoosek(adj.size(), sample, &rng);
+            for (unsigned int i = 0; i < sample.size(); i++) {
+                infect(sample[i]);
+            }
+            return;
+        }
+
+        void infect(Node* node) { infect( node_index(node) ); }
+
+        int next_event() {
+            const double exposure_rate = mu * exposed.size();
+            const double recovery_rate = gamma * infectious.size();
+            const double contact_total = contact_rate == PER_NODE ? beta * infectious.size() : beta * infectious_deg_sum;
+            const double total = exposure_rate + recovery_rate + contact_total;
+
+            if (total == 0.0 and waning.empty()) return 0;
+
+            const double Tnext = total > 0.0 ? Now + rand_exp(total, &rng) : numeric_limits<double>::infinity();
+            if (not waning.empty() and waning.front().first <= Tnext) {
+                // loss of immunity comes first; the other rates are memoryless, so
+                // the time drawn for them can be thrown away
+                Now = waning.front().first;
+                int node = waning.front().second;
+                waning.pop_front();
+                set_state(node, SUSCEPTIBLE);
+                return 1;
+            }
+            Now = Tnext;
+
+            double r = rand_uniform(0, total, &rng);
+            if (r < exposure_rate) {
+                int node = exposed[ rand_uniform_int(0, exposed.size() - 1, &rng) ];
+                remove(exposed, node);
+                infectious.push_back(node);
+                position[node] = infectious.size() - 1;
+                infectious_deg_sum += adj.deg(node);
+                set_state(node, INFECTIOUS);
+            } else if (r < exposure_rate + recovery_rate) {
+                int node = infectious[ rand_uniform_int(0, infectious.size() - 1, &rng) ];
+                remove(infectious, node);
+                infectious_deg_sum -= adj.deg(node);
+                set_state(node, RESISTANT);
+                waning.push_back( make_pair(Now + immunity_duration, node) );
+            } else {
+                int node = rand_contacting_node();
+                if (adj.deg(node) > 0) {
+                    int contact = adj.neighbors[ adj.begin(node) + rand_uniform_int(0, adj.deg(node) - 1, &rng) ];
+                    if ( state[contact] == SUSCEPTIBLE ) infect(contact);
+                }
+            }
+            return 1;
+        }
+
+    private:
+        Adjacency adj;
+        int max_deg;
+        vector<int> state;          // by node index
+        vector<int> position;       // where each node is in exposed or infectious
+        vector<int> exposed;
+        vector<int> infectious;
+        long infectious_deg_sum;
+        deque< pair<double, int> > waning; // (time of loss of immunity, node), in time order
+        unordered_map<const Node*, int> index;
+
+        int node_index(Node* node) {
+            if (index.empty()) {
+                for (int i = 0; i < adj.size(); i++) index[ adj.nodes[i] ] = i;
+            }
+            return index[node];
+        }
+
+        void set_state(int node, stateType s) {
+            state_counts[ state[node] ]--;
+            state_counts[s]++;
+            state[node] = s;
+            adj.nodes[node]->set_state(s);
+        }
+
+        void infect(int node) {
+            assert(state[node] == SUSCEPTIBLE);
+            exposed.push_back(node);
+            position[node] = exposed.size() - 1;
+            set_state(node, EXPOSED);
+        }
+
+        // O(1) removal: move the last element into the gap
+        void remove(vector<int>& list, int node) {
+            int pos = position[node];
+            list[pos] = list.back();
+            position[ list[pos] ] = pos;
+            list.pop_back();
+            position[node] = -1;
+        }
+
+        int rand_contacting_node() {
+            if (contact_rate == PER_NODE) return infectious[ rand_uniform_int(0, infectious.size() - 1, &rng) ];
+            while (true) {
+                int node = infectious[ rand_uniform_int(0, infectious.size() - 1, &rng) ];
+                if (rand_uniform(0, max_deg, &rng) < adj.deg(node)) return node;
+            }
+        }
+};
+#endif
@@ -11,16 +11,19 @@ using namespace std;
 class SIR : public DiffEq_Sim {
 
     private:
-        const double beta;
-        const double gamma;
+        double beta;
+        double gamma;
 
     public:
         SIR() : beta(0.0), gamma(0.0) { nbins=3;}
         SIR(double b, double g): beta(b), gamma(g) { nbins=3; }
         ~SIR() {};
 
+        // for reusing one instance across parameter values; follow with initialize()
+        void set_parameters(double b, double g) { beta = b; gamma = g; }
+
         void initialize( double S, double I, double R) {
-            y = new double[nbins];
+            init_state();
             y[0] = S; y[1] = I; y[2] = R;
         }
 
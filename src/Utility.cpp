@@ -121,23 +121,27 @@ int rand_nonuniform_int(vector<double> dist, std::mt19937* rng) {
 
 int rand_uniform_int (int min, int max, std::mt19937* rng) {
     // uniform integer on [min, max] (inclusive)
+    INSTRUMENT_COUNT("RNG draws", 1);
     std::uniform_int_distribution<> dist(min, max);
     return dist(*rng);
 }
 
    
 double rand_uniform (double min, double max, std::mt19937* rng) {
+    INSTRUMENT_COUNT("RNG draws", 1);
     std::uniform_real_distribution<> dist(min, max);
     return dist(*rng);
 }
 
 double rand_normal(double mean, double std_dev, std::mt19937* rng) {
+    INSTRUMENT_COUNT("RNG draws", 1);
     std::normal_distribution<> dist(mean, std_dev);
     return dist(*rng);
 }
 
 
 double rand_exp(double lambda, std::mt19937* rng) {
+    INSTRUMENT_COUNT("RNG draws", 1);
     std::uniform_real_distribution<> dist(0, 1);
     return -log(dist(*rng)) / lambda; //TODO: could return inf if 0 happens to be returned
 }
@@ -273,6 +277,7 @@ void split(const string& s, char c, vector<string>& v) {
 
 
 vector<double> read_vector_file(string filename) {
+    INSTRUMENT_SPAN("read_vector_file");
 //    cerr << "Loading " << filename << endl;
     ifstream myfile(filename.c_str());
 
@@ -287,6 +292,7 @@ vector<double> read_vector_file(string filename) {
 }
 
 vector<vector<double> > read_2D_vector_file(string filename, char sep) {
+    INSTRUMENT_SPAN("read_2D_vector_file");
  //   cerr << "Loading " << filename << endl;
     ifstream myfile(filename.c_str());
 
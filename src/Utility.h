@@ -11,6 +11,7 @@
 #include <fstream>
 #include <iostream>
 #include <random>
+#include "Instrument.h"
 
 using namespace std;
 